@@ -0,0 +1,262 @@
+/*
+ * Scale test and microbenchmark of the process list: every operation is checked
+ * against a simple model of the list, and the cost of each function is printed
+ * in ns/op as one JSON object per line
+ *
+ * Usage: ./bench_proclist [number of processes]
+ */
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "proclist.h"
+
+// Model of a process of the list
+typedef struct model {
+    int pid;     // PID of the process (0 if the ID is not used)
+    state state; // Expected state
+    long stamp;  // Time of the last modification, in operations
+} model;
+
+static model *models; // Indexed by ID
+static int maxID;     // Size of models
+static int *liveIDs;  // IDs used by a process, in no particular order
+static long clockTick = 0;
+static volatile long checksum; // Keeps the results of the timed lookups alive under NDEBUG
+
+static char *command[] = {"sleep", "1000", NULL};
+
+static double now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static void report(const char *function, int n, double start) {
+    printf("{\"bench\": \"proclist\", \"function\": \"%s\", \"operations\": %d, \"ns_per_op\": %.1f}\n",
+           function, n, (now() - start) / n);
+}
+
+// Random permutation of the IDs 1..n
+static int *shuffledIDs(int n) {
+    int *ids = malloc(n * sizeof(int));
+    for (int i = 0; i < n; i++) {
+        ids[i] = i + 1;
+    }
+    for (int i = n - 1; i > 0; i--) {
+        int j = rand() % (i + 1);
+        int tmp = ids[i];
+        ids[i] = ids[j];
+        ids[j] = tmp;
+    }
+    return ids;
+}
+
+// Check the whole list against the model
+static void checkInvariants(proc_t *head) {
+    int n = 0, previousListID = 0;
+    proc_t previous = NULL;
+    for (proc_t current = *head; current != NULL; current = current->next) {
+        // Sorted by unique IDs, consistent links
+        assert(current->id > previousListID);
+        assert(current->prev == previous);
+        assert(current->id < maxID && models[current->id].pid == current->pid);
+        assert(current->state == models[current->id].state);
+        previousListID = current->id;
+        previous = current;
+        n++;
+    }
+
+    // Same processes as the model, current and previous jobs are the last two modified
+    int used = 0, lastID = 0, previousID = 0;
+    for (int id = 1; id < maxID; id++) {
+        if (models[id].pid == 0) {
+            continue;
+        }
+        used++;
+        if (lastID == 0 || models[id].stamp > models[lastID].stamp) {
+            previousID = lastID;
+            lastID = id;
+        }
+        else if (previousID == 0 || models[id].stamp > models[previousID].stamp) {
+            previousID = id;
+        }
+    }
+    assert(used == n && lengthProcList(head) == n);
+    int last, prev;
+    getLastTwoProcesses(head, &last, &prev);
+    assert(last == lastID && prev == previousID);
+}
+
+static int lowestFreeID() {
+    int id = 1;
+    while (id < maxID && models[id].pid != 0) {
+        id++;
+    }
+    return id;
+}
+
+// Random mix of operations, each checked against the model
+static void testRandomOperations(int n) {
+    proc_t *head = initProcList();
+    int live = 0, nextPID = 1000;
+    for (int i = 0; i < n; i++) {
+        int op = rand() % 5;
+        if (op >= 3 || live == 0) { // Add (twice as likely, so the list grows)
+            int expected = lowestFreeID();
+            int id = addProcess(head, nextPID, ACTIVE, command);
+            assert(id == expected && id < maxID);
+            models[id] = (model){nextPID++, ACTIVE, ++clockTick};
+            liveIDs[live++] = id;
+        }
+        else {
+            // Pick a random live process
+            int k = rand() % live;
+            int id = liveIDs[k];
+            int pid = models[id].pid;
+            assert(getID(head, pid) == id && getPID(head, id) == pid);
+            assert(getProcessStatusByPID(head, pid) == models[id].state);
+            if (op == 1) { // Change the status
+                state status = rand() % 2 ? SUSPENDED : ACTIVE;
+                setProcessStatusByPID(head, pid, status);
+                models[id].state = status;
+                models[id].stamp = ++clockTick;
+            }
+            else { // Remove
+                if (op == 2) {
+                    removeProcessByPID(head, pid);
+                }
+                else {
+                    removeProcessByID(head, id);
+                }
+                assert(getID(head, pid) == 0 && getPID(head, id) == 0);
+                assert(getProcessStatusByPID(head, pid) == UNDEFINED);
+                models[id].pid = 0;
+                liveIDs[k] = liveIDs[--live];
+            }
+        }
+        if (i % 1000 == 0) {
+            checkInvariants(head);
+        }
+    }
+    checkInvariants(head);
+    deleteProcList(head);
+    memset(models, 0, maxID * sizeof(model));
+}
+
+// Time each function on n processes, accessed in random orders
+static void benchFunctions(int n) {
+    proc_t *head = initProcList();
+    int *ids = shuffledIDs(n);
+    double start;
+
+    start = now();
+    for (int i = 0; i < n; i++) {
+        addProcess(head, 100000 + i, ACTIVE, command);
+    }
+    report("addProcess", n, start);
+
+    long sum = 0, expected = 0;
+    for (int i = 0; i < n; i++) {
+        expected += ids[i];
+    }
+
+    start = now();
+    for (int i = 0; i < n; i++) {
+        int pid = getPID(head, ids[i]);
+        assert(pid == 100000 + ids[i] - 1);
+        sum += pid;
+    }
+    report("getPID", n, start);
+    assert(sum == expected + 99999L * n);
+    checksum += sum;
+
+    start = now();
+    sum = 0;
+    for (int i = 0; i < n; i++) {
+        int id = getID(head, 100000 + ids[i] - 1);
+        assert(id == ids[i]);
+        sum += id;
+    }
+    report("getID", n, start);
+    assert(sum == expected);
+    checksum += sum;
+
+    start = now();
+    for (int i = 0; i < n; i++) {
+        setProcessStatusByPID(head, 100000 + ids[i] - 1, SUSPENDED);
+    }
+    report("setProcessStatusByPID", n, start);
+
+    start = now();
+    sum = 0;
+    for (int i = 0; i < n; i++) {
+        int state = getProcessStatusByPID(head, 100000 + ids[i] - 1);
+        assert(state == SUSPENDED);
+        sum += state;
+    }
+    report("getProcessStatusByPID", n, start);
+    assert(sum == (long) SUSPENDED * n);
+    checksum += sum;
+
+    start = now();
+    int last, previous;
+    for (int i = 0; i < n; i++) {
+        getLastTwoProcesses(head, &last, &previous);
+    }
+    report("getLastTwoProcesses", n, start);
+
+    start = now();
+    for (int i = 0; i < n / 2; i++) {
+        removeProcessByID(head, ids[i]);
+    }
+    report("removeProcessByID", n / 2, start);
+
+    // Reuse the freed IDs
+    start = now();
+    for (int i = 0; i < n / 2; i++) {
+        addProcess(head, 200000 + i, ACTIVE, command);
+    }
+    report("addProcess (reused IDs)", n / 2, start);
+    assert(lengthProcList(head) == n);
+
+    // Sweep every process as DONE, the printed lines are discarded
+    for (int i = 0; i < n; i++) {
+        setProcessStatusByID(head, ids[i], DONE);
+    }
+    fflush(stdout);
+    int savedStdout = dup(STDOUT_FILENO);
+    int devNull = open("/dev/null", O_WRONLY);
+    dup2(devNull, STDOUT_FILENO);
+    start = now();
+    updateProcList(head);
+    fflush(stdout);
+    dup2(savedStdout, STDOUT_FILENO);
+    close(devNull);
+    close(savedStdout);
+    report("updateProcList (per process)", n, start);
+    assert(*head == NULL);
+
+    free(ids);
+    deleteProcList(head);
+}
+
+int main(int argc, char **argv) {
+    int n = argc > 1 ? atoi(argv[1]) : 100000;
+    srand(42);
+    maxID = n + 2;
+    models = calloc(maxID, sizeof(model));
+    liveIDs = malloc(maxID * sizeof(int));
+
+    testRandomOperations(n);
+    benchFunctions(n);
+
+    free(models);
+    free(liveIDs);
+    return 0;
+}
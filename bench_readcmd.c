@@ -0,0 +1,75 @@
+/*
+ * Microbenchmark of the command line tokenizer on long generated lines
+ *
+ * Usage: ./bench_readcmd [lines] [words per line]
+ * The scanner can be chosen with MINISHELL_SCANNER=scalar|sse2|avx2
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "readcmd.h"
+
+#define REPETITIONS 5
+
+int main(int argc, char **argv) {
+    int lines = argc > 1 ? atoi(argv[1]) : 100;
+    int words = argc > 2 ? atoi(argv[2]) : 20000;
+
+    // Generate the script: words of 1 to 16 letters, separated by one space
+    size_t size = (size_t)lines * words * 17 + 1;
+    char *script = malloc(size);
+    char *copy = malloc(size);
+    if (script == NULL || copy == NULL) {
+        perror("malloc");
+        return 1;
+    }
+    srand(42);
+    size_t len = 0;
+    for (int l = 0; l < lines; l++) {
+        for (int w = 0; w < words; w++) {
+            int wordLength = 1 + rand() % 16;
+            for (int c = 0; c < wordLength; c++) {
+                script[len++] = 'a' + rand() % 26;
+            }
+            script[len++] = w + 1 < words ? ' ' : '\n';
+        }
+    }
+
+    double best = 0;
+    long tokens = 0;
+    for (int r = 0; r < REPETITIONS; r++) {
+        // The lines are terminated in place, start from a fresh copy
+        memcpy(copy, script, len);
+        copy[len] = 0;
+        readcmd_from(copy, len);
+
+        struct timespec start, end;
+        struct cmdline *cmd;
+        tokens = 0;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        while ((cmd = readcmd()) != NULL) {
+            for (int i = 0; cmd->seq[i] != NULL; i++) {
+                for (int j = 0; cmd->seq[i][j] != NULL; j++) {
+                    tokens++;
+                }
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        if (r == 0 || seconds < best) {
+            best = seconds;
+        }
+    }
+
+    const char *scanner = getenv("MINISHELL_SCANNER");
+    printf("{\"bench\": \"tokenize\", \"scanner\": \"%s\", \"lines\": %d, \"bytes\": %zu, "
+           "\"tokens\": %ld, \"seconds\": %.6f, \"tokens_per_sec\": %.0f, \"mb_per_sec\": %.1f}\n",
+           scanner != NULL ? scanner : "auto", lines, len, tokens, best, tokens / best,
+           len / best / 1e6);
+    free(script);
+    free(copy);
+    return 0;
+}
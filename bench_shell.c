@@ -0,0 +1,265 @@
+/*
+ * End-to-end benchmarks of the minishell: each workload is written to a script run by
+ * "minishell <script>", and the results are printed as one JSON object per line
+ *
+ * Usage: ./bench_shell [path to minishell]
+ */
+
+#define _GNU_SOURCE // mkstemp
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// Number of samples of each workload (at most)
+#define SAMPLES 9
+
+static const char *minishell = "./minishell";
+
+static double now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static int compareDoubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Value below which p percent of the sorted samples are
+static double percentile(const double *sorted, int n, double p) {
+    return sorted[(int)(p / 100 * (n - 1) + 0.5)];
+}
+
+/*
+ * Function: writeScript
+ * ---------------------
+ *   Write a script made of a header, count times the same line and a footer
+ *
+ *   Return: the path of the script (to free and unlink)
+ */
+static char *writeScript(const char *header, const char *line, int count, const char *footer) {
+    char *path = strdup("/tmp/minishell_bench_XXXXXX");
+    int fd = mkstemp(path);
+    FILE *script = fd >= 0 ? fdopen(fd, "w") : NULL;
+    if (script == NULL) {
+        perror("mkstemp");
+        exit(EXIT_FAILURE);
+    }
+    fputs(header, script);
+    for (int i = 0; i < count; i++) {
+        fputs(line, script);
+    }
+    fputs(footer, script);
+    fclose(script);
+    return path;
+}
+
+// Run the minishell on a script, its output discarded, and return the elapsed time
+static double runScript(const char *path) {
+    double start = now();
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        exit(EXIT_FAILURE);
+    }
+    if (pid == 0) {
+        if (freopen("/dev/null", "w", stdout) == NULL) {
+            _exit(127);
+        }
+        execl(minishell, minishell, path, (char *)NULL);
+        perror(minishell);
+        _exit(127);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "bench: %s exited abnormally on %s\n", minishell, path);
+    }
+    return now() - start;
+}
+
+// Run a script n times and print the percentiles of the time per unit of work
+static void report(const char *name, const char *path, int n, int units, const char *unit) {
+    double samples[SAMPLES];
+    for (int i = 0; i < n; i++) {
+        samples[i] = runScript(path) / units * 1e6;
+    }
+    qsort(samples, n, sizeof(double), compareDoubles);
+    printf("{\"bench\": \"%s\", \"samples\": %d, \"%s_per_sample\": %d, \"p50_us\": %.2f, "
+           "\"p90_us\": %.2f, \"p99_us\": %.2f, \"max_us\": %.2f}\n",
+           name, n, unit, units, percentile(samples, n, 50), percentile(samples, n, 90),
+           percentile(samples, n, 99), samples[n - 1]);
+    fflush(stdout);
+}
+
+// Latency of a trivial external command (true alone is a built-in command)
+static void benchSpawn() {
+    const int commands = 200;
+    char *path = writeScript("", "/bin/true\n", commands, "");
+    report("spawn_true", path, SAMPLES, commands, "commands");
+    unlink(path);
+    free(path);
+}
+
+// Throughput of a pipeline moving data through several processes
+static void benchPipeline(int stages, long megabytes) {
+    char line[256];
+    int n = snprintf(line, sizeof(line), "head -c %ldM /dev/zero", megabytes);
+    for (int i = 1; i < stages - 1; i++) {
+        n += snprintf(line + n, sizeof(line) - n, " | cat");
+    }
+    snprintf(line + n, sizeof(line) - n, " | wc -c\n");
+    char *path = writeScript("", line, 1, "");
+
+    double samples[SAMPLES];
+    for (int i = 0; i < SAMPLES; i++) {
+        samples[i] = megabytes / runScript(path);
+    }
+    qsort(samples, SAMPLES, sizeof(double), compareDoubles);
+    printf("{\"bench\": \"pipeline\", \"stages\": %d, \"megabytes\": %ld, \"samples\": %d, "
+           "\"p50_mb_per_sec\": %.1f, \"min_mb_per_sec\": %.1f, \"max_mb_per_sec\": %.1f}\n",
+           stages, megabytes, SAMPLES, percentile(samples, SAMPLES, 50), samples[0],
+           samples[SAMPLES - 1]);
+    fflush(stdout);
+    unlink(path);
+    free(path);
+}
+
+// Throughput and context switches of a process pipeline with a given pipe capacity
+static void benchPipeSize(const char *size, long megabytes) {
+    char header[64], line[256];
+    snprintf(header, sizeof(header), "pipesize %s\n", size);
+    snprintf(line, sizeof(line), "head -c %ldM /dev/zero | /bin/cat | /bin/cat | wc -c\n",
+             megabytes);
+    char *path = writeScript(header, line, 1, "");
+
+    double samples[3];
+    long switches = 0;
+    for (int i = 0; i < 3; i++) {
+        // The processes of the pipeline are waited for by the shell, itself waited for here
+        struct rusage before, after;
+        getrusage(RUSAGE_CHILDREN, &before);
+        samples[i] = megabytes / runScript(path);
+        getrusage(RUSAGE_CHILDREN, &after);
+        switches += (after.ru_nvcsw + after.ru_nivcsw) - (before.ru_nvcsw + before.ru_nivcsw);
+    }
+    qsort(samples, 3, sizeof(double), compareDoubles);
+    printf("{\"bench\": \"pipe_size\", \"pipe_size\": \"%s\", \"megabytes\": %ld, "
+           "\"samples\": 3, \"p50_mb_per_sec\": %.1f, \"context_switches_per_mb\": %.1f}\n",
+           size, megabytes, samples[1], (double)switches / 3 / megabytes);
+    fflush(stdout);
+    unlink(path);
+    free(path);
+}
+
+// Cost of starting and tracking a large number of background jobs
+static void benchBackgroundJobs() {
+    const int jobs = 10000;
+    char *path = writeScript("", "/bin/true &\n", jobs, "list\n");
+    report("background_jobs", path, 3, jobs, "jobs");
+    unlink(path);
+    free(path);
+}
+
+// Commands per second of a built-in utility and of the external program it replaces
+static void benchBuiltin(const char *name, const char *builtin, const char *external) {
+    const int commands = 200;
+    double rates[2];
+    const char *lines[2] = {builtin, external};
+    for (int i = 0; i < 2; i++) {
+        char *path = writeScript("", lines[i], commands, "");
+        double samples[SAMPLES];
+        for (int j = 0; j < SAMPLES; j++) {
+            samples[j] = commands / runScript(path);
+        }
+        qsort(samples, SAMPLES, sizeof(double), compareDoubles);
+        rates[i] = percentile(samples, SAMPLES, 50);
+        unlink(path);
+        free(path);
+    }
+    printf("{\"bench\": \"builtin_%s\", \"samples\": %d, \"commands_per_sample\": %d, "
+           "\"p50_builtin_per_sec\": %.0f, \"p50_external_per_sec\": %.0f, \"speedup\": %.1f}\n",
+           name, SAMPLES, commands, rates[0], rates[1], rates[0] / rates[1]);
+    fflush(stdout);
+}
+
+// Throughput of a command line using the cat optimizations and of the same one with /bin/cat
+static void benchCat(const char *name, const char *format, const char *file, long megabytes) {
+    double rates[2];
+    const char *cats[2] = {"cat", "/bin/cat"};
+    for (int i = 0; i < 2; i++) {
+        char line[512];
+        snprintf(line, sizeof(line), format, cats[i], file);
+        char *path = writeScript("", line, 1, "");
+        double samples[3];
+        for (int j = 0; j < 3; j++) {
+            samples[j] = megabytes / runScript(path);
+        }
+        qsort(samples, 3, sizeof(double), compareDoubles);
+        rates[i] = samples[1];
+        unlink(path);
+        free(path);
+    }
+    printf("{\"bench\": \"cat_%s\", \"megabytes\": %ld, \"samples\": 3, "
+           "\"p50_builtin_mb_per_sec\": %.1f, \"p50_external_mb_per_sec\": %.1f, "
+           "\"speedup\": %.2f}\n",
+           name, megabytes, rates[0], rates[1], rates[0] / rates[1]);
+    fflush(stdout);
+}
+
+// cat replaced by a redirection, splice between pipes and sendfile to a file, on a sparse file
+static void benchCats(long megabytes) {
+    char file[] = "/tmp/minishell_bench_XXXXXX";
+    int fd = mkstemp(file);
+    if (fd < 0 || ftruncate(fd, megabytes << 20) < 0) {
+        perror("mkstemp");
+        exit(EXIT_FAILURE);
+    }
+    close(fd);
+    benchCat("redirection", "%s %s | wc -l\n", file, megabytes);
+    benchCat("splice", "cat %2$s | %1$s | wc -l\n", file, megabytes);
+    benchCat("sendfile", "%s %s > /dev/null\n", file, megabytes);
+    unlink(file);
+}
+
+// Parsing of long command lines (cd only uses its first argument, nothing is spawned)
+static void benchLongLines() {
+    const int lines = 200, words = 5000;
+    size_t size = 5 + 8 * words + 2;
+    char *line = malloc(size);
+    strcpy(line, "cd .");
+    size_t n = strlen(line);
+    for (int i = 0; i < words; i++) {
+        n += sprintf(line + n, " arg%04d", i);
+    }
+    strcpy(line + n, "\n");
+    char *path = writeScript("", line, lines, "");
+    report("long_lines", path, SAMPLES, lines, "lines");
+    unlink(path);
+    free(path);
+    free(line);
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        minishell = argv[1];
+    }
+    benchSpawn();
+    benchBuiltin("echo", "echo hello world\n", "/bin/echo hello world\n");
+    benchBuiltin("test", "test 1 -lt 2\n", "/usr/bin/test 1 -lt 2\n");
+    benchBuiltin("printf", "printf %s-%d\\n a 1\n", "/usr/bin/printf %s-%d\\n a 1\n");
+    benchPipeline(4, 256);
+    benchPipeSize("64K", 1024);
+    benchPipeSize("256K", 1024);
+    benchPipeSize("1M", 1024);
+    benchCats(2048);
+    benchBackgroundJobs();
+    benchLongLines();
+    return 0;
+}
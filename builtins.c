@@ -1,109 +1,437 @@
+#include <errno.h>
+#include <limits.h>
 #include <signal.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
 #include "builtins.h"
 #include "debug.h"
+#include "parallel.h"
+#include "pathcache.h"
+#include "pipes.h"
 #include "proclist.h"
+#include "shell.h"
+#include "stats.h"
+#include "trace.h"
+#include "utilities.h"
 
-void cd(struct cmdline *cmd) {
+int cd(char **argv, int in, int out, proc_t *procList) {
+    (void)in;
+    (void)out;
+    (void)procList;
     DEBUG_PRINT("Executing built-in command 'cd'\n");
-    char *newDir = cmd->seq[0][1];
+    char *newDir = argv[1];
     if (newDir == NULL) { // No arguments given to cd
         char *HOME = getenv("HOME");
         DEBUG_PRINT("cd: Changing current directory to HOME\n");
         setenv("PWD", HOME, true);
-        chdir(HOME);
+        return chdir(HOME) < 0;
     }
-    else {
-        DEBUG_PRINTF("cd: Trying to change current directory to %s\n", newDir);
-        if (chdir(newDir) != -1) {
-            setenv("PWD", newDir, true);
-        }
-        else {
-            printf("minishell: cd: %s: No such file or directory\n", newDir);
-        }
+    DEBUG_PRINTF("cd: Trying to change current directory to %s\n", newDir);
+    if (chdir(newDir) < 0) {
+        printf("minishell: cd: %s: No such file or directory\n", newDir);
+        return 1;
     }
+    setenv("PWD", newDir, true);
+    return 0;
 }
 
-void exitShell(proc_t *procList) {
+int exitShell(char **argv, int in, int out, proc_t *procList) {
+    (void)in;
+    (void)out;
     DEBUG_PRINT("exit: exiting shell ...\n");
+    int status = (argv != NULL && argv[1] != NULL) ? atoi(argv[1]) : EXIT_SUCCESS;
     deleteProcList(procList);
-    exit(EXIT_SUCCESS);
+    fflush(stdout);
+    exit(status);
 }
 
-void list(proc_t *procList) {
+int list(char **argv, int in, int out, proc_t *procList) {
+    (void)in;
+    (void)out;
     DEBUG_PRINT("Executing built-in command 'list'\n");
-    printProcList(procList);
+    if (argv[1] != NULL && !strcmp(argv[1], "-l")) {
+        printProcListUsage(procList);
+    }
+    else {
+        printProcList(procList);
+    }
+    return 0;
 }
 
-int cmdlineToPID(struct cmdline *cmd, proc_t *procList) {
-    int lastID, previousID, id;
+// ID of the job given as argument (+, - or its ID), the last modified one by default
+static int argvToID(char **argv, proc_t *procList) {
+    int lastID, previousID;
     getLastTwoProcesses(procList, &lastID, &previousID);
-    int pid = getPID(procList, lastID); // If no arguments, return last modified process
-    if (cmd->seq[0][1] != NULL) {
-        if (*(cmd->seq[0][1]) == '+')
+    int id = lastID; // If no arguments, return last modified process
+    if (argv[1] != NULL) {
+        if (*argv[1] == '+')
             id = lastID;
-        else if (*(cmd->seq[0][1]) == '-')
+        else if (*argv[1] == '-')
             id = previousID;
         else
-            id = atoi(cmd->seq[0][1]);
-        pid = getPID(procList, id);
+            id = atoi(argv[1]);
     }
-    return pid;
+    return getProcessStatusByID(procList, id) != UNDEFINED ? id : 0;
 }
 
-void stop(struct cmdline *cmd, proc_t *procList) {
+int stop(char **argv, int in, int out, proc_t *procList) {
+    (void)in;
+    (void)out;
     DEBUG_PRINT("Executing built-in command 'stop'\n");
 
-    int pid = cmdlineToPID(cmd, procList);
-    if (pid == 0) { // No process found
+    int id = argvToID(argv, procList);
+    if (id == 0) { // No process found
         printf("minishell: stop: no such job\n");
-        return;
+        return 1;
+    }
+    // A queued job has no process group yet, killpg(0) would stop the shell
+    if (getProcessStatusByID(procList, id) == QUEUED) {
+        printf("minishell: stop: job %d is queued\n", id);
+        return 1;
     }
+    int pid = getPID(procList, id);
 
-    kill(pid, SIGTSTP);
+    killpg(pid, SIGTSTP);
     DEBUG_PRINTF("[%d] Process stopped\n", pid);
     setProcessStatusByPID(procList, pid, SUSPENDED);
     printProcessByPID(procList, pid);
+    return 0;
 }
 
-void bg(struct cmdline *cmd, proc_t *procList) {
+int bg(char **argv, int in, int out, proc_t *procList) {
+    (void)in;
+    (void)out;
     DEBUG_PRINT("Executing built-in command 'bg'\n");
 
-    int pid = cmdlineToPID(cmd, procList);
-    if (pid == 0) { // No process found
+    int id = argvToID(argv, procList);
+    if (id == 0) { // No process found
         printf("minishell: bg: no such job\n");
-        return;
+        return 1;
+    }
+    if (getProcessStatusByID(procList, id) == QUEUED) { // Started without waiting for a slot
+        return startQueuedJob(id) != 0 ? 0 : 1;
     }
+    int pid = getPID(procList, id);
 
-    kill(pid, SIGCONT);
+    killpg(pid, SIGCONT);
     DEBUG_PRINTF("[%d] Process resumed\n", pid);
+    return 0;
 }
 
-void fg(struct cmdline *cmd, proc_t *procList, int *foregroundPID, bool *stopReceived) {
+int fg(char **argv, int in, int out, proc_t *procList) {
+    (void)in;
+    (void)out;
     DEBUG_PRINT("Executing built-in command 'fg'\n");
 
-    int pid = cmdlineToPID(cmd, procList);
-    if (pid == 0) { // No process found
+    int id = argvToID(argv, procList);
+    if (id == 0) { // No process found
         printf("minishell: fg: no such job\n");
-        return;
+        return 1;
+    }
+    bool queued = getProcessStatusByID(procList, id) == QUEUED;
+    int pid = queued ? startQueuedJob(id) : getPID(procList, id);
+    if (pid == 0) {
+        return 1;
     }
 
-    kill(pid, SIGCONT);
-    DEBUG_PRINTF("[%d] Process resumed\n", pid);
+    // The job is resumed once it owns the terminal
+    fflush(stdout);
+    waitForeground(pid, !queued);
+
+    DEBUG_PRINTF("[%d] Process finished or stopped\n", pid);
+    return 0;
+}
+
+// Exit status of a job, from the wait status of its last process
+static int exitCode(int status) {
+    return WIFSIGNALED(status) ? 128 + WTERMSIG(status) : WEXITSTATUS(status);
+}
+
+// Exit status of an ended job, which is forgotten once waited for
+static int waitedJob(proc_t *procList, int id) {
+    int status = exitCode(getProcessExitStatusByPID(procList, getPID(procList, id)));
+    removeProcessByID(procList, id);
+    return status;
+}
+
+// Is a job waited for by wait -n still able to end (running or queued) ?
+static bool pendingJob(proc_t *procList, int id) {
+    state status = getProcessStatusByID(procList, id);
+    return status == ACTIVE || status == QUEUED;
+}
+
+int waitCommand(char **argv, int in, int out, proc_t *procList) {
+    (void)in;
+    (void)out;
+    DEBUG_PRINT("Executing built-in command 'wait'\n");
+    // The jobs are children of the shell, not of a forked built-in command
+    if (forkedBuiltin) {
+        return 127;
+    }
+    bool any = argv[1] != NULL && !strcmp(argv[1], "-n");
+    char **args = argv + 1 + any;
+    int argc = 0;
+    while (argv[argc] != NULL) {
+        argc++;
+    }
+    int ids[argc];
+    int count = 0, status = 0;
+    for (; *args != NULL; args++) {
+        char *end;
+        long id = strtol(**args == '%' ? *args + 1 : *args, &end, 10);
+        if (*end != '\0' || id <= 0 || id > INT_MAX ||
+            getProcessStatusByID(procList, id) == UNDEFINED) {
+            printf("minishell: wait: %s: no such job\n", *args);
+            status = 127;
+        }
+        else {
+            ids[count++] = id;
+        }
+    }
+    if (count == 0 && argv[1 + any] != NULL) {
+        return status;
+    }
 
-    *foregroundPID = pid;
+    interruptReceived = false;
+    if (any) { // The first job to end among the given ones (or all of them)
+        while (!interruptReceived) {
+            bool pending = false;
+            if (count == 0) {
+                for (proc_t job = *procList; job != NULL; job = job->next) {
+                    if (job->state == DONE) {
+                        return waitedJob(procList, job->id);
+                    }
+                    pending = pending || job->state == ACTIVE || job->state == QUEUED;
+                }
+            }
+            for (int i = 0; i < count; i++) {
+                if (getProcessStatusByID(procList, ids[i]) == DONE) {
+                    return waitedJob(procList, ids[i]);
+                }
+                pending = pending || pendingJob(procList, ids[i]);
+            }
+            if (!pending) {
+                return 127;
+            }
+            handleEvents();
+        }
+    }
+    else if (count == 0) { // Every running job, their status is forgotten
+        while (!interruptReceived &&
+               countProcesses(procList, ACTIVE) + countProcesses(procList, QUEUED) > 0) {
+            handleEvents();
+        }
+        for (proc_t job = *procList, next; job != NULL; job = next) {
+            next = job->next;
+            if (job->state == DONE) {
+                removeProcessByID(procList, job->id);
+            }
+        }
+        status = 0;
+    }
+    else { // Each given job, the status is the one of the last job
+        for (int i = 0; i < count && !interruptReceived; i++) {
+            while (!interruptReceived && pendingJob(procList, ids[i])) {
+                handleEvents();
+            }
+            state jobStatus = getProcessStatusByID(procList, ids[i]);
+            if (jobStatus == DONE) {
+                status = waitedJob(procList, ids[i]);
+            }
+            else if (jobStatus == SUSPENDED) { // It can't end until it is resumed
+                status = 128 + SIGTSTP;
+            }
+        }
+    }
+    return interruptReceived ? 128 + SIGINT : status;
+}
 
-    // Wait for the child to finish or to be stopped
-    while (!(*stopReceived)) {
-        sleep(0.1);
+int hash(char **argv, int in, int out, proc_t *procList) {
+    (void)in;
+    (void)out;
+    (void)procList;
+    DEBUG_PRINT("Executing built-in command 'hash'\n");
+    char **args = argv + 1;
+    if (*args == NULL) {
+        printCommandCache();
+        return 0;
+    }
+    int status = 0;
+    for (; *args != NULL; args++) {
+        if (!strcmp(*args, "-r")) {
+            clearCommandCache();
+        }
+        else if (findCommand(*args) == NULL) {
+            printf("minishell: hash: %s: not found\n", *args);
+            status = 1;
+        }
     }
-    // Reset stopReceived and foregroundPID values
-    *stopReceived = false;
-    *foregroundPID = 0;
+    return status;
+}
 
-    DEBUG_PRINTF("[%d] Process finished or stopped\n", pid);
-}
\ No newline at end of file
+int maxjobs(char **argv, int in, int out, proc_t *procList) {
+    (void)in;
+    (void)out;
+    DEBUG_PRINT("Executing built-in command 'maxjobs'\n");
+    if (argv[1] == NULL) {
+        if (getMaxJobs() == 0) {
+            printf("unlimited (%d queued)\n", countProcesses(procList, QUEUED));
+        }
+        else {
+            printf("%d (%d queued)\n", getMaxJobs(), countProcesses(procList, QUEUED));
+        }
+        return 0;
+    }
+    char *end;
+    long max = strtol(argv[1], &end, 10);
+    if (!strcmp(argv[1], "unlimited")) {
+        max = 0;
+    }
+    else if (*argv[1] == '\0' || *end != '\0' || max > INT_MAX || max < 0) {
+        printf("minishell: maxjobs: %s: invalid number\n", argv[1]);
+        return 1;
+    }
+    setMaxJobs(max);
+    return 0;
+}
+
+int pipesize(char **argv, int in, int out, proc_t *procList) {
+    (void)in;
+    (void)out;
+    (void)procList;
+    DEBUG_PRINT("Executing built-in command 'pipesize'\n");
+    if (argv[1] == NULL) {
+        printf("%d bytes (maximum %d)\n", getPipeSize(), maxPipeSize());
+        return 0;
+    }
+    int size = parsePipeSize(argv[1]);
+    if (size < 0 || setPipeSize(size) < 0) {
+        printf("minishell: pipesize: %s: invalid size\n", argv[1]);
+        return 1;
+    }
+    return 0;
+}
+
+int trace(char **argv, int in, int out, proc_t *procList) {
+    (void)in;
+    (void)out;
+    (void)procList;
+    DEBUG_PRINT("Executing built-in command 'trace'\n");
+    if (argv[1] == NULL) {
+        printf("trace: %s, %ld events\n", traceEnabled ? "on" : "off", countTraceEvents());
+    }
+    else if (!strcmp(argv[1], "on") || !strcmp(argv[1], "off")) {
+        setTracing(!strcmp(argv[1], "on"));
+    }
+    else if (!strcmp(argv[1], "clear")) {
+        clearTrace();
+    }
+    else if (!strcmp(argv[1], "dump") && argv[2] != NULL) {
+        if (dumpTrace(argv[2]) < 0) {
+            printf("minishell: trace: %s: %s\n", argv[2], strerror(errno));
+            return 1;
+        }
+    }
+    else {
+        printf("minishell: trace: usage: trace [on | off | clear | dump file]\n");
+        return 1;
+    }
+    return 0;
+}
+
+int stats(char **argv, int in, int out, proc_t *procList) {
+    (void)in;
+    (void)out;
+    (void)procList;
+    DEBUG_PRINT("Executing built-in command 'stats'\n");
+    if (argv[1] == NULL) {
+        printStats();
+    }
+    else if (!strcmp(argv[1], "-r")) {
+        resetStats();
+    }
+    else {
+        printf("minishell: stats: usage: stats [-r]\n");
+        return 1;
+    }
+    return 0;
+}
+
+// Table of the built-in commands, a new built-in command only needs to be added here
+static const struct {
+    const char *name;
+    builtinFunction function;
+} builtins[] = {
+    {"[", test},
+    {"bg", bg},
+    {"cd", cd},
+    {"echo", echo},
+    {"exit", exitShell},
+    {"false", falseCommand},
+    {"fg", fg},
+    {"hash", hash},
+    {"jobs", list},
+    {"list", list},
+    {"maxjobs", maxjobs},
+    {"parallel", parallel},
+    {"pipesize", pipesize},
+    {"printf", printfCommand},
+    {"pwd", pwd},
+    {"stats", stats},
+    {"stop", stop},
+    {"test", test},
+    {"trace", trace},
+    {"true", trueCommand},
+    {"wait", waitCommand},
+};
+
+#define BUILTIN_COUNT (sizeof(builtins) / sizeof(builtins[0]))
+
+// Number of slots of the lookup table, a power of two at least twice the number of commands
+#define BUILTIN_SLOTS 64
+
+_Static_assert(2 * BUILTIN_COUNT <= BUILTIN_SLOTS, "BUILTIN_SLOTS is too small");
+
+// Open addressing table of indexes in builtins (+1, 0 is an empty slot), filled on first use
+static unsigned char slots[BUILTIN_SLOTS];
+static bool slotsFilled = false;
+
+// FNV-1a hash of a command name
+static unsigned int hashName(const char *name) {
+    uint32_t h = 2166136261u;
+    for (const unsigned char *c = (const unsigned char *)name; *c != '\0'; c++) {
+        h = (h ^ *c) * 16777619u;
+    }
+    return h & (BUILTIN_SLOTS - 1);
+}
+
+static void fillSlots() {
+    for (unsigned int i = 0; i < BUILTIN_COUNT; i++) {
+        unsigned int slot = hashName(builtins[i].name);
+        while (slots[slot] != 0) {
+            slot = (slot + 1) & (BUILTIN_SLOTS - 1);
+        }
+        slots[slot] = i + 1;
+    }
+    slotsFilled = true;
+}
+
+builtinFunction findBuiltin(const char *name) {
+    if (!slotsFilled) {
+        fillSlots();
+    }
+    // At most half of the slots are used: a lookup is one hash and a short probe sequence
+    for (unsigned int slot = hashName(name); slots[slot] != 0;
+         slot = (slot + 1) & (BUILTIN_SLOTS - 1)) {
+        if (!strcmp(builtins[slots[slot] - 1].name, name)) {
+            return builtins[slots[slot] - 1].function;
+        }
+    }
+    return NULL;
+}
@@ -1,31 +1,43 @@
 /*
  * Built-in commands of the minishell
+ *
+ * Every built-in command has the same signature: it receives its arguments and the
+ * descriptors of its input and output, and returns its exit status. The standard output
+ * of the shell is redirected to out while a built-in command runs, so it can use printf.
  */
 
 #ifndef __BUILTINS_H
 #define __BUILTINS_H
 
 #include "proclist.h"
-#include "readcmd.h"
+
+typedef int (*builtinFunction)(char **argv, int in, int out, proc_t *procList);
+
+/*
+ * Function: findBuiltin
+ * ---------------------
+ *   Look for a built-in command in the table of built-in commands
+ *
+ *   name: the name of the command
+ *
+ *   Return: the function implementing the command, NULL if it is not a built-in command
+ */
+builtinFunction findBuiltin(const char *name);
 
 /*
  * Function: cd
  * ------------
  *   Change the current directory, if an empty string is given,
  *   the current directory changed to the environment variable HOME
- *
- *   cmd: the command line
  */
-void cd(struct cmdline *cmd);
+int cd(char **argv, int in, int out, proc_t *procList);
 
 /*
  * Function: exitShell
  * -------------------
  *   Exit the shell
- *
- *   procList: the process list
  */
-void exitShell(proc_t *procList);
+int exitShell(char **argv, int in, int out, proc_t *procList);
 
 /*
  * Function: list
@@ -38,42 +50,85 @@ void exitShell(proc_t *procList);
  *     [3]+  Running                 sleep 1000 &
  *
  *   Notes: '+' and '-' are displayed respectively for the last and
- *   the second-to-last modified processes
- *
- *   procList: the process list
+ *   the second-to-last modified processes. With -l, the resources used by
+ *   the reaped processes of each job are displayed as well
  */
-void list(proc_t *procList);
+int list(char **argv, int in, int out, proc_t *procList);
 
 /*
  * Function: stop
  * --------------
  *   Suspend a process
- *
- *   cmd: the command line
- *   procList: the process list
  */
-void stop(struct cmdline *cmd, proc_t *procList);
+int stop(char **argv, int in, int out, proc_t *procList);
 
 /*
  * Function: bg
  * ------------
  *   Resume a background process
- *
- *   cmd: the command line
- *   procList: the process list
  */
-void bg(struct cmdline *cmd, proc_t *procList);
+int bg(char **argv, int in, int out, proc_t *procList);
 
 /*
  * Function: fg
  * ------------
  *   Take to foreground and resume a background process
+ */
+int fg(char **argv, int in, int out, proc_t *procList);
+
+/*
+ * Function: waitCommand
+ * ---------------------
+ *   Wait until the given jobs (IDs, with an optional %) end and forget them, the
+ *   status is the one of the last job. Without jobs, wait for every running job.
+ *   With -n, wait for the first of the given jobs (or of every job) to end.
  *
- *   cmd: the command line
- *   procList: the process list
- *   foregroundPID: the PID of the foreground process
- *   stopReceived: has the foreground process been stopped ?
+ *   Return: the exit status of the job (128 + the signal which killed it), 127 if
+ *   there is no such job, 128 + SIGINT if interrupted by CTRL+C
+ */
+int waitCommand(char **argv, int in, int out, proc_t *procList);
+
+/*
+ * Function: hash
+ * --------------
+ *   Manage the cache of command locations: without arguments, print the cache,
+ *   with -r, empty the cache, otherwise look for each given command and cache it
+ */
+int hash(char **argv, int in, int out, proc_t *procList);
+
+/*
+ * Function: maxjobs
+ * -----------------
+ *   Without arguments, print the maximum number of background jobs running at the
+ *   same time and the number of queued jobs, otherwise set it (a number, 0 or
+ *   "unlimited" for no limit)
+ */
+int maxjobs(char **argv, int in, int out, proc_t *procList);
+
+/*
+ * Function: pipesize
+ * ------------------
+ *   Without arguments, print the capacity of the pipes created between the commands
+ *   and the largest one allowed, otherwise set it (in bytes, with an optional K or M
+ *   suffix, or "default")
+ */
+int pipesize(char **argv, int in, int out, proc_t *procList);
+
+/*
+ * Function: stats
+ * ---------------
+ *   Print the latency percentiles of each phase of the commands (parse, setup,
+ *   spawn, reap, whole command), with -r, empty the histograms
+ */
+int stats(char **argv, int in, int out, proc_t *procList);
+
+/*
+ * Function: trace
+ * ---------------
+ *   Control the tracing of the shell: without arguments, print whether it is on and
+ *   the number of recorded events, otherwise turn it on or off, forget the events
+ *   (clear) or write them to a file in the Chrome trace event format (dump file)
  */
-void fg(struct cmdline *cmd, proc_t *procList, int *foregroundPID, bool *stopReceived);
+int trace(char **argv, int in, int out, proc_t *procList);
 
-#endif
\ No newline at end of file
+#endif
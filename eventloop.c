@@ -0,0 +1,97 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "eventloop.h"
+
+// Maximum number of events handled by a single call to epoll_wait
+#define MAX_EVENTS 64
+
+struct eventSource {
+    int fd;                   // The watched file descriptor
+    eventCallback callback;   // Function to call when fd is ready (NULL once removed)
+    void *data;               // Argument given to the callback
+    struct eventSource *next; // Next removed source waiting to be freed
+};
+
+static int epollFD = -1;
+
+// Sources removed while dispatching events, freed once the whole batch is handled
+// (a pending event of the batch may still reference them)
+static eventSource *removedSources = NULL;
+
+void initEventLoop() {
+    epollFD = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFD < 0) {
+        perror("epoll_create1");
+        exit(EXIT_FAILURE);
+    }
+}
+
+eventSource *addEventSource(int fd, eventCallback callback, void *data) {
+    eventSource *source = safe_malloc(sizeof(eventSource));
+    source->fd = fd;
+    source->callback = callback;
+    source->data = data;
+    source->next = NULL;
+
+    struct epoll_event event = {.events = EPOLLIN, .data.ptr = source};
+    if (epoll_ctl(epollFD, EPOLL_CTL_ADD, fd, &event) < 0) {
+        free(source);
+        if (errno == EPERM) { // Regular files are always ready and can't be polled
+            DEBUG_PRINTF("File descriptor %d can't be polled\n", fd);
+            return NULL;
+        }
+        perror("epoll_ctl");
+        exit(EXIT_FAILURE);
+    }
+    DEBUG_PRINTF("Watching file descriptor %d\n", fd);
+    return source;
+}
+
+void enableEventSource(eventSource *source, bool enabled) {
+    struct epoll_event event = {.events = enabled ? EPOLLIN : 0, .data.ptr = source};
+    if (epoll_ctl(epollFD, EPOLL_CTL_MOD, source->fd, &event) < 0) {
+        perror("epoll_ctl");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void removeEventSource(eventSource *source) {
+    if (epoll_ctl(epollFD, EPOLL_CTL_DEL, source->fd, NULL) < 0) {
+        perror("epoll_ctl");
+    }
+    DEBUG_PRINTF("Stopped watching file descriptor %d\n", source->fd);
+    source->callback = NULL;
+    source->next = removedSources;
+    removedSources = source;
+}
+
+void runEventLoopOnce() {
+    struct epoll_event events[MAX_EVENTS];
+    int n = epoll_wait(epollFD, events, MAX_EVENTS, -1);
+    if (n < 0) {
+        if (errno != EINTR) {
+            perror("epoll_wait");
+            exit(EXIT_FAILURE);
+        }
+        return;
+    }
+
+    for (int i = 0; i < n; i++) {
+        eventSource *source = events[i].data.ptr;
+        if (source->callback != NULL) {
+            source->callback(source->fd, source->data);
+        }
+    }
+
+    // Free the sources removed by the callbacks
+    while (removedSources != NULL) {
+        eventSource *next = removedSources->next;
+        free(removedSources);
+        removedSources = next;
+    }
+}
@@ -0,0 +1,62 @@
+/*
+ * Event loop of the minishell, built on epoll
+ */
+
+#ifndef __EVENTLOOP_H
+#define __EVENTLOOP_H
+
+#include <stdbool.h>
+
+// Function called when a watched file descriptor is ready
+typedef void (*eventCallback)(int fd, void *data);
+
+// A file descriptor watched by the event loop
+typedef struct eventSource eventSource;
+
+/*
+ * Function: initEventLoop
+ * -----------------------
+ *   Initialize the event loop, must be called before any other function of this module
+ */
+void initEventLoop();
+
+/*
+ * Function: addEventSource
+ * ------------------------
+ *   Watch a file descriptor for readability (or hang up)
+ *
+ *   fd: the file descriptor to watch
+ *   callback: the function called with fd and data when fd is ready
+ *   data: a pointer given back to the callback
+ *
+ *   Return: the created source, or NULL if fd can't be polled (e.g. a regular file)
+ */
+eventSource *addEventSource(int fd, eventCallback callback, void *data);
+
+/*
+ * Function: enableEventSource
+ * ---------------------------
+ *   Start or stop reporting the events of a source, without removing it
+ *
+ *   source: the source to modify
+ *   enabled: true to report the events, false to ignore them
+ */
+void enableEventSource(eventSource *source, bool enabled);
+
+/*
+ * Function: removeEventSource
+ * ---------------------------
+ *   Stop watching a source and free it, the file descriptor is not closed
+ *
+ *   source: the source to remove
+ */
+void removeEventSource(eventSource *source);
+
+/*
+ * Function: runEventLoopOnce
+ * --------------------------
+ *   Wait until at least one source is ready and call the callbacks of every ready source
+ */
+void runEventLoopOnce();
+
+#endif
@@ -9,159 +9,522 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/signalfd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
 #include "builtins.h"
 #include "debug.h"
+#include "eventloop.h"
+#include "pathcache.h"
+#include "pipes.h"
 #include "proclist.h"
 #include "readcmd.h"
+#include "shell.h"
+#include "spawn.h"
+#include "stats.h"
+#include "trace.h"
+#include "utilities.h"
 
-// Global variables (used in signal handlers)
-proc_t *procList;          // The process list
-int foregroundPID = 0;     // PID of the foreground process
-struct cmdline *cmd;       // The last command line entered
-bool stopReceived = false; // CTRL+Z received by foreground process ?
+// Global variables (used in event handlers)
+proc_t *procList;               // The process list
+int foregroundPID = 0;          // Process group of the foreground job (PID of its first process)
+struct cmdline *cmd;            // The last command line entered
+bool stopReceived = false;      // CTRL+Z received by foreground process ?
+bool inputReady = false;        // Can a command line be read from standard input ?
+sigset_t originalMask;          // Signal mask of the shell at startup, restored in children
+bool interactive = false;       // Is the shell reading commands from a terminal ?
+struct rusage foregroundUsage;  // Resources used by the last foreground job
+bool interruptReceived = false; // CTRL+C received while no job was in foreground ?
+bool forkedBuiltin = false;     // Is this process a built-in command forked by the shell ?
+int maxJobs = 0;                // Maximum number of running background jobs, 0 for no limit
+int savedOutput = -1;           // Output of the shell while a built-in command redirects it
+
+// A background command line waiting for a running background job to end
+typedef struct queuedJob {
+    int id;                 // ID of the job in the process list (QUEUED)
+    struct cmdline *cmd;    // Copy of the command line
+    struct queuedJob *next; // Next job of the queue
+} queuedJob;
+queuedJob *queueHead = NULL; // The oldest queued job, started first
+queuedJob *queueTail = NULL; // The newest queued job
+
+// A child whose end is reported by a pidfd
+typedef struct childWatch {
+    int pid;             // PID of the child
+    eventSource *source; // The pidfd in the event loop
+} childWatch;
+bool pidfdEnabled = true; // Are the ends of the children reported by pidfds ?
+
+void childHandler();
+void watchChild(int pid);
+
+/*
+ * Function: waitForeground
+ * ------------------------
+ *   Make a job the foreground job and handle events until it ends or is stopped
+ *
+ *   pgid: the process group of the job
+ *   resume: send SIGCONT to the job once it owns the terminal ?
+ */
+void waitForeground(int pgid, bool resume) {
+    // The job may have ended while the shell was running a built-in command
+    memset(&foregroundUsage, 0, sizeof(struct rusage));
+    state status = getProcessStatusByPID(procList, pgid);
+    if (status == UNDEFINED || status == DONE) {
+        getProcessUsageByPID(procList, pgid, &foregroundUsage);
+        removeProcessByPID(procList, pgid);
+        return;
+    }
+
+    DEBUG_PRINTF("[%d] Parent process waiting for its job %d\n", getpid(), pgid);
+    TRACE(TRACE_WAIT_BEGIN, pgid, resume, NULL);
+    foregroundPID = pgid;
+    if (interactive) { // CTRL+Z and CTRL+C are sent by the terminal to the job itself
+        tcsetpgrp(STDIN_FILENO, pgid);
+    }
+    if (resume) {
+        killpg(pgid, SIGCONT);
+    }
+    // Handle events until the job finishes or is stopped
+    while (!stopReceived) {
+        runEventLoopOnce();
+    }
+    if (interactive) {
+        tcsetpgrp(STDIN_FILENO, getpgrp());
+    }
+    // Reset stopReceived and foregroundPID values
+    stopReceived = false;
+    foregroundPID = 0;
+    TRACE(TRACE_WAIT_END, pgid, 0, NULL);
+    DEBUG_PRINTF("[%d] Job %d stopped or ended\n", getpid(), pgid);
+}
+
+/*
+ * Function: handleEvents
+ * ----------------------
+ *   Wait for the next events and handle them, the jobs are updated as in waitForeground
+ *
+ *   Notes: the event loop belongs to the shell, a forked built-in command only waits for
+ *   its children
+ */
+void handleEvents() {
+    if (!forkedBuiltin) {
+        runEventLoopOnce();
+        return;
+    }
+    sigset_t childSignal;
+    sigemptyset(&childSignal);
+    sigaddset(&childSignal, SIGCHLD);
+    if (sigwaitinfo(&childSignal, NULL) == SIGCHLD) {
+        childHandler();
+    }
+}
 
 /*
  * Function: execExternalCommand
  * -----------------------------
- *   Execute an external command, a subprocess will be forked
+ *   Execute an external command in a subprocess
  *
  *   in: the input descriptor
  *   out: the output descriptor
- *   cmd: the command to execute
- *   i: the index of the command to execute in cmd
- *   procList: the process list
+ *   argv: the command and its arguments
+ *   pgid: the process group of the job, 0 to start a new group
+ *
+ *   Return: the PID of the subprocess, -1 if it couldn't be created
  */
-void execExternalCommand(int in, int out, struct cmdline *cmd, int i, proc_t *procList) {
-    int forkPID;
+int execExternalCommand(int in, int out, char **argv, int pgid) {
+    int childPID;
+    char *name = argv[0];
 
-    fflush(stdout);   // Flush stdout to give an empty buffer to the child process
-    forkPID = fork(); // Make a child process to execute the command
+    // Resolve the command before creating a process, so that a typo costs no fork
+    const char *path = findCommand(name);
+    if (path == NULL) {
+        printf("minishell: %s: command not found\n", name);
+        return -1;
+    }
 
-    if (forkPID < 0) {
-        perror("fork");
-        exit(1);
+    fflush(stdout); // Flush stdout to give an empty buffer to the child process
+    uint64_t spawnStart = statsClock();
+    childPID = spawnCommand(in, out, path, argv, &originalMask, pgid);
+    if (childPID < 0 && errno == ENOENT) {
+        // The cached file was removed, look for the command in PATH again
+        forgetCommand(name);
+        path = findCommand(name);
+        if (path == NULL) {
+            printf("minishell: %s: command not found\n", name);
+            return -1;
+        }
+        childPID = spawnCommand(in, out, path, argv, &originalMask, pgid);
     }
-    else if (forkPID == 0) { // Child process
 
-        DEBUG_PRINTF("[%d] Child process executing command '%s'\n", getpid(), cmd->seq[i][0]);
-        // Handle input redirection
+    if (childPID < 0) {
+        perror(name);
+    }
+    else {
+        recordLatency(STAT_SPAWN, spawnStart);
+        TRACE(TRACE_SPAWN, childPID, pgid != 0 ? pgid : childPID, name);
+        watchChild(childPID);
+    }
+    return childPID;
+}
+
+/*
+ * Function: forkBuiltin
+ * ---------------------
+ *   Execute a built-in command in a subprocess, used when it runs in background
+ *   or when another built-in command of its pipeline runs in the shell
+ *
+ *   builtin: the built-in command
+ *   in: the input descriptor
+ *   out: the output descriptor
+ *   argv: the command and its arguments
+ *   pgid: the process group of the job, 0 to start a new group
+ *
+ *   Return: the PID of the subprocess, -1 if it couldn't be created
+ */
+int forkBuiltin(builtinFunction builtin, int in, int out, char **argv, int pgid) {
+    fflush(stdout); // Flush stdout to give an empty buffer to the child process
+    uint64_t spawnStart = statsClock();
+    int childPID = fork();
+    if (childPID == 0) {
+        // Same environment as an external command, except SIGCHLD which is read by
+        // handleEvents for the built-in commands starting their own processes
+        sigset_t mask = originalMask;
+        sigaddset(&mask, SIGCHLD);
+        sigprocmask(SIG_SETMASK, &mask, NULL);
+        forkedBuiltin = true;
+        setpgid(0, pgid);
         if (in != STDIN_FILENO) {
-            DEBUG_PRINTF("Input read from %d\n", in);
             dup2(in, STDIN_FILENO);
             close(in);
         }
-
-        // Handle output redirection
         if (out != STDOUT_FILENO) {
-            DEBUG_PRINTF("Output redirected to %d\n", out);
             dup2(out, STDOUT_FILENO);
             close(out);
         }
+        // Close the descriptors of the shell like an exec would: the pipes of the other stages
+        // must not keep a reader or a writer in this process
+        close_range(3, ~0U, 0);
+        int status = builtin(argv, STDIN_FILENO, STDOUT_FILENO, procList);
+        fflush(stdout);
+        _exit(status);
+    }
+    if (childPID < 0) {
+        perror("fork");
+    }
+    else {
+        recordLatency(STAT_SPAWN, spawnStart);
+        setpgid(childPID, pgid); // Also in the parent: the group must exist when the call returns
+        TRACE(TRACE_SPAWN, childPID, pgid != 0 ? pgid : childPID, argv[0]);
+        watchChild(childPID);
+    }
+    return childPID;
+}
 
-        // We need to set the child process in its own group, otherwise
-        // it will receive SIGTSTP when CTRL+Z is pressed
-        setsid();
-        execvp(cmd->seq[i][0], cmd->seq[i]);
-        printf("Unknown command\n"); // If execvp returns, the command has failed
-        exit(EXIT_FAILURE);
+/*
+ * Function: runBuiltin
+ * --------------------
+ *   Execute a built-in command in the shell process, its standard output
+ *   is redirected to out while it runs
+ *
+ *   builtin: the built-in command
+ *   in: the input descriptor
+ *   out: the output descriptor
+ *   argv: the command and its arguments
+ *
+ *   Return: the exit status of the command
+ */
+int runBuiltin(builtinFunction builtin, int in, int out, char **argv) {
+    if (out != STDOUT_FILENO) {
+        fflush(stdout);
+        savedOutput = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 0);
+        dup2(out, STDOUT_FILENO);
     }
-    else { // Parent process
-        if (cmd->backgrounded) {
-            int newID = addProcess(procList, forkPID, ACTIVE, cmd->seq[i]);
-            printProcessByID(procList, newID);
-        }
-        else {
-            if (cmd->seq[i + 1] == NULL) { // Don't wait for piped processes
-                DEBUG_PRINTF("[%d] Parent process waiting for its child %d\n", getpid(), forkPID);
-                foregroundPID = forkPID;
-                // Wait for the child to finish or to be stopped
-                while (!stopReceived) {
-                    sleep(0.1);
-                }
-                // Reset stopReceived and foregroundPID values
-                stopReceived = false;
-                foregroundPID = 0;
-            }
-            DEBUG_PRINTF("[%d] Child %d stopped or ended\n", getpid(), forkPID);
-        }
+    TRACE(TRACE_BUILTIN_BEGIN, 0, 0, argv[0]);
+    int status = builtin(argv, in, out, procList);
+    TRACE(TRACE_BUILTIN_END, 0, status, argv[0]);
+    if (savedOutput >= 0) {
+        fflush(stdout);
+        clearerr(stdout); // The reader of a pipe may have exited
+        dup2(savedOutput, STDOUT_FILENO);
+        close(savedOutput);
+        savedOutput = -1;
     }
+    return status;
 }
 
 /*
- * Function: treatCommand
+ * Function: printTime
+ * -------------------
+ *   Print the times used by a command line, for the time keyword
+ *
+ *   start: the time at which the command line started
+ *   selfStart: the resources used by the shell when the command line started
+ *   job: the resources used by the processes of the command line
+ */
+void printTime(const struct timespec *start, const struct rusage *selfStart,
+               const struct rusage *job) {
+    struct timespec end;
+    struct rusage self;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    getrusage(RUSAGE_SELF, &self);
+    // The built-in commands run by the shell count as well
+    double real = (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+    double user = job->ru_utime.tv_sec + job->ru_utime.tv_usec / 1e6 +
+                  (self.ru_utime.tv_sec - selfStart->ru_utime.tv_sec) +
+                  (self.ru_utime.tv_usec - selfStart->ru_utime.tv_usec) / 1e6;
+    double sys = job->ru_stime.tv_sec + job->ru_stime.tv_usec / 1e6 +
+                 (self.ru_stime.tv_sec - selfStart->ru_stime.tv_sec) +
+                 (self.ru_stime.tv_usec - selfStart->ru_stime.tv_usec) / 1e6;
+    fflush(stdout);
+    fprintf(stderr, "\nreal\t%dm%.6fs\nuser\t%dm%.6fs\nsys\t%dm%.6fs\n", (int)real / 60,
+            real - 60 * ((int)real / 60), (int)user / 60, user - 60 * ((int)user / 60),
+            (int)sys / 60, sys - 60 * ((int)sys / 60));
+}
+
+/*
+ * Function: stageBuiltin
  * ----------------------
- *   Treat a given command
+ *   Find the built-in command executing a stage of a pipeline
  *
- *   cmd: the command to treat
+ *   argv: the command and its arguments
+ *
+ *   Return: the built-in command, NULL if the stage is an external command
  */
-void treatCommand(struct cmdline *cmd, proc_t *procList) {
-    char *cmdName = cmd->seq[0][0];
-    if (!strcmp(cmdName, "cd")) {
-        cd(cmd);
+builtinFunction stageBuiltin(char **argv) {
+    builtinFunction builtin = findBuiltin(argv[0]);
+#if OPTIMIZE_CAT
+    // cat without options is a relay between descriptors, done by the shell without copies
+    if (builtin == NULL && isPlainCat(argv)) {
+        builtin = cat;
     }
-    else if (!strcmp(cmdName, "exit")) {
-        exitShell(procList);
+#endif
+    return builtin;
+}
+
+/*
+ * Function: jobNameWords
+ * ----------------------
+ *   Number of words of the name of the job of a command line, with its NULL pointer
+ *
+ *   cmd: the command line
+ */
+size_t jobNameWords(struct cmdline *cmd) {
+    size_t words = 0;
+    for (int i = 0; cmd->seq[i] != NULL; i++) {
+        for (char **arg = cmd->seq[i]; *arg != NULL; arg++) {
+            words++;
+        }
+        words++; // "|" or NULL
     }
-    else if (!strcmp(cmdName, "list") || !strcmp(cmdName, "jobs")) {
-        list(procList);
+    return words;
+}
+
+/*
+ * Function: getJobName
+ * --------------------
+ *   Name the job of a command line after the whole command line
+ *
+ *   cmd: the command line
+ *   jobName: set to the words of the commands separated by "|", room for
+ *   jobNameWords(cmd) words
+ */
+void getJobName(struct cmdline *cmd, char **jobName) {
+    size_t n = 0;
+    for (int i = 0; cmd->seq[i] != NULL; i++) {
+        if (i > 0) {
+            jobName[n++] = "|";
+        }
+        for (char **arg = cmd->seq[i]; *arg != NULL; arg++) {
+            jobName[n++] = *arg;
+        }
     }
-    else if (!strcmp(cmdName, "stop")) {
-        stop(cmd, procList);
+    jobName[n] = NULL;
+}
+
+/*
+ * Function: launchCommand
+ * -----------------------
+ *   Start the processes of a command line and wait for them unless it is in background
+ *
+ *   cmd: the command line
+ *   jobID: the ID of the job of the command line if it was queued, 0 to create one
+ */
+void launchCommand(struct cmdline *cmd, proc_t *procList, int jobID) {
+    uint64_t setupStart = statsClock();
+    bool queued = jobID != 0;
+    // Handle pipes and redirections
+    int in, out, finalOutput, fd[2];
+
+    // Open input file
+    if (cmd->in != NULL) {
+        in = open(cmd->in, O_RDONLY | O_CLOEXEC);
+        if (in < 0) {
+            printf("minishell: %s: No such file or directory\n", cmd->in);
+            if (queued) {
+                removeProcessByID(procList, jobID);
+            }
+            return;
+        }
     }
-    else if (!strcmp(cmdName, "bg")) {
-        bg(cmd, procList);
+    else {
+        in = STDIN_FILENO;
     }
-    else if (!strcmp(cmdName, "fg")) {
-        fg(cmd, procList, &foregroundPID, &stopReceived);
+
+    // Open output file
+    if (cmd->out != NULL) {
+        finalOutput = open(cmd->out, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (finalOutput < 0) {
+            perror(cmd->out);
+            if (in != STDIN_FILENO) {
+                close(in);
+            }
+            if (queued) {
+                removeProcessByID(procList, jobID);
+            }
+            return;
+        }
     }
     else {
-        // Handle pipes and redirections
-        int in, out, finalOutput, fd[2];
-
-        // Open input file
-        if (cmd->in != NULL) {
-            in = open(cmd->in, O_RDONLY);
-            if (in < 0) {
-                printf("minishell: %s: No such file or directory\n", cmd->in);
-                exit(EXIT_FAILURE);
-            }
+        finalOutput = STDOUT_FILENO;
+    }
+
+    // "time" in front of a command line reports the time used by the whole pipeline
+    bool timed = false;
+    struct timespec start;
+    struct rusage selfStart;
+    if (!strcmp(cmd->seq[0][0], "time") && cmd->seq[0][1] != NULL) {
+        timed = !cmd->backgrounded;
+        cmd->seq[0]++;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        getrusage(RUSAGE_SELF, &selfStart);
+        memset(&foregroundUsage, 0, sizeof(struct rusage));
+    }
+
+    int stages = 0;
+    while (cmd->seq[stages] != NULL) {
+        stages++;
+    }
+
+    char ***seq = cmd->seq;
+#if OPTIMIZE_CAT
+    // A leading "cat file" only copies a file to the next stage, which can read the file itself
+    if (stages > 1 && in == STDIN_FILENO && isPlainCat(seq[0]) && seq[0][1] != NULL &&
+        seq[0][2] == NULL && strcmp(seq[0][1], "-") != 0) {
+        int file = open(seq[0][1], O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if (file >= 0 && fstat(file, &st) == 0 && !S_ISDIR(st.st_mode)) {
+            DEBUG_PRINTF("cat %s replaced by an input redirection\n", seq[0][1]);
+            in = file;
+            seq++;
+            stages--;
         }
-        else {
-            in = STDIN_FILENO;
+        else if (file >= 0) { // Let cat report the error
+            close(file);
         }
+    }
+#endif
 
-        // Open output file
-        if (cmd->out != NULL) {
-            finalOutput = open(cmd->out, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-            if (finalOutput < 0) {
-                perror("open");
-                exit(EXIT_FAILURE);
-            }
+    // A built-in command runs in the shell unless it is in background. The shell runs one at
+    // most, the last one: two of them connected through the pipeline, even by external
+    // commands, would wait for each other once a pipe is full. The others run in subprocesses.
+    int shellStage = -1;
+    for (int i = 0; i < stages && !cmd->backgrounded; i++) {
+        builtinFunction builtin = stageBuiltin(seq[i]);
+#if OPTIMIZE_CAT && !CAT_IN_SHELL
+        if (builtin == cat) { // The relay runs in a subprocess, like the cat it replaces
+            continue;
         }
-        else {
-            finalOutput = STDOUT_FILENO;
+#endif
+        if (builtin != NULL) {
+            shellStage = i;
         }
+    }
+    // It runs once every process of the pipeline exists, so that the shell never blocks on a
+    // full pipe without a reader
+    struct {
+        builtinFunction builtin;
+        int in, out;
+        char **argv;
+    } deferred = {NULL, STDIN_FILENO, STDOUT_FILENO, NULL};
 
-        // Create a pipe between each consecutive process
-        for (int i = 0; cmd->seq[i] != NULL; i++) {
-            if (cmd->seq[i + 1] != NULL) {
-                pipe(fd);
-                out = fd[1];
-            }
-            else { // Redirect the last command
-                out = finalOutput;
+    // The processes of the pipeline form one job, in the process group of its first process,
+    // named after the whole command line
+    int pgid = 0;
+    // A foreground job gets the terminal as soon as its process group exists, before the
+    // built-in command of the shell runs: a stage reading the terminal from a background
+    // group would be stopped by SIGTTIN while the shell waits for it
+    bool terminalGiven = interactive && !cmd->backgrounded;
+    char *jobName[jobNameWords(cmd)];
+    getJobName(cmd, jobName);
+
+    // Create a pipe between each consecutive process
+    for (int i = 0; i < stages; i++) {
+        if (i + 1 < stages) {
+            if (openPipe(fd) < 0) {
+                // Abort the pipeline, the stages already started would wait for the next ones
+                perror("minishell: pipe");
+                if (pgid != 0) {
+                    killpg(pgid, SIGTERM);
+                }
+                if (in != STDIN_FILENO) {
+                    close(in);
+                }
+                if (finalOutput != STDOUT_FILENO) {
+                    close(finalOutput);
+                }
+                if (deferred.out != STDOUT_FILENO) {
+                    close(deferred.out);
+                }
+                if (deferred.in != STDIN_FILENO) {
+                    close(deferred.in);
+                }
+                deferred.builtin = NULL;
+                break;
             }
+            out = fd[1];
+        }
+        else { // Redirect the last command
+            out = finalOutput;
+        }
 
+        builtinFunction builtin = stageBuiltin(seq[i]);
+        if (i == shellStage) {
+            deferred.builtin = builtin;
+            deferred.in = in;
+            deferred.out = out;
+            deferred.argv = seq[i];
+        }
+        else {
             // in is assigned in the previous iteration
-            execExternalCommand(in, out, cmd, i, procList);
+            int childPID = (builtin != NULL) ? forkBuiltin(builtin, in, out, seq[i], pgid)
+                                             : execExternalCommand(in, out, seq[i], pgid);
+            if (childPID > 0 && pgid == 0 && queued) {
+                pgid = childPID;
+                addProcessMember(procList, jobID, childPID);
+                setProcessStatusByID(procList, jobID, ACTIVE);
+            }
+            else if (childPID > 0 && pgid == 0) {
+                pgid = childPID;
+                jobID = addProcess(procList, childPID, ACTIVE, jobName);
+                if (terminalGiven) {
+                    tcsetpgrp(STDIN_FILENO, pgid);
+                }
+            }
+            else if (childPID > 0) {
+                addProcessMember(procList, jobID, childPID);
+            }
             // Close the pipe because it is not used in the parent process
             if (out != STDOUT_FILENO && close(out) < 0) {
                 perror("close output");
@@ -169,68 +532,359 @@ void treatCommand(struct cmdline *cmd, proc_t *procList) {
             if (in != STDIN_FILENO && close(in) < 0) {
                 perror("close input");
             }
+        }
 
-            // The next child will read from the current pipe
-            in = fd[0];
+        // The next child will read from the current pipe
+        in = fd[0];
+    }
+    recordLatency(STAT_SETUP, setupStart);
+
+    terminalGiven = terminalGiven && pgid != 0;
+    if (terminalGiven) { // Resume the stages which read the terminal before it was given
+        killpg(pgid, SIGCONT);
+    }
+    if (deferred.builtin != NULL) {
+        runBuiltin(deferred.builtin, deferred.in, deferred.out, deferred.argv);
+        // Closing the pipe gives end of file to the next command
+        if (deferred.out != STDOUT_FILENO) {
+            close(deferred.out);
+        }
+        if (deferred.in != STDIN_FILENO) {
+            close(deferred.in);
         }
     }
+
+    if (queued && pgid == 0) { // No process could be started
+        removeProcessByID(procList, jobID);
+    }
+    else if (jobID != 0 && cmd->backgrounded && !queued) {
+        printProcessByID(procList, jobID);
+    }
+    else if (jobID != 0 && !cmd->backgrounded) {
+        waitForeground(pgid, false);
+    }
+    if (terminalGiven) { // Also when the job ended before waitForeground
+        tcsetpgrp(STDIN_FILENO, getpgrp());
+    }
+    if (timed) {
+        printTime(&start, &selfStart, &foregroundUsage);
+    }
+}
+
+/*
+ * Function: runningJobs
+ * ---------------------
+ *   Number of running background jobs, the foreground job isn't limited by maxJobs
+ */
+int runningJobs() {
+    int running = countProcesses(procList, ACTIVE);
+    if (foregroundPID != 0 && getProcessStatusByPID(procList, foregroundPID) == ACTIVE) {
+        running--;
+    }
+    return running;
+}
+
+/*
+ * Function: startQueuedJob
+ * ------------------------
+ *   Start a queued job now, whatever the number of running background jobs
+ *
+ *   Notes: the job gets the standard output of the shell, even when it is started
+ *   while a built-in command (wait, parallel, bg, fg) has it redirected
+ *
+ *   id: the ID of the job
+ *
+ *   Return: the process group of the job, 0 if it isn't queued or couldn't be started
+ */
+int startQueuedJob(int id) {
+    queuedJob *previous = NULL, *job = queueHead;
+    while (job != NULL && job->id != id) {
+        previous = job;
+        job = job->next;
+    }
+    if (job == NULL) {
+        return 0;
+    }
+    if (previous != NULL) {
+        previous->next = job->next;
+    }
+    else {
+        queueHead = job->next;
+    }
+    if (queueTail == job) {
+        queueTail = previous;
+    }
+    DEBUG_PRINTF("Starting queued job %d\n", id);
+    int builtinOutput = -1;
+    if (savedOutput >= 0) {
+        fflush(stdout);
+        builtinOutput = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 0);
+        dup2(savedOutput, STDOUT_FILENO);
+    }
+    launchCommand(job->cmd, procList, id);
+    if (builtinOutput >= 0) {
+        fflush(stdout);
+        dup2(builtinOutput, STDOUT_FILENO);
+        close(builtinOutput);
+    }
+    free(job->cmd);
+    free(job);
+    return getPID(procList, id);
+}
+
+/*
+ * Function: startQueuedJobs
+ * -------------------------
+ *   Start the queued jobs, in the order they were entered, while the limit allows it
+ */
+void startQueuedJobs() {
+    // The queue of a forked built-in command is a copy, its jobs belong to the shell
+    if (forkedBuiltin) {
+        return;
+    }
+    while (queueHead != NULL && (maxJobs == 0 || runningJobs() < maxJobs)) {
+        startQueuedJob(queueHead->id);
+    }
+}
+
+/*
+ * Function: setMaxJobs
+ * --------------------
+ *   Set the maximum number of background jobs running at the same time and start
+ *   the queued jobs which now fit
+ *
+ *   max: the maximum number of jobs, 0 for no limit
+ *
+ *   Return: 0 on success, -1 if max is invalid
+ */
+int setMaxJobs(int max) {
+    if (max < 0) {
+        return -1;
+    }
+    maxJobs = max;
+    startQueuedJobs();
+    return 0;
+}
+
+/*
+ * Function: getMaxJobs
+ * --------------------
+ *   Return: the maximum number of running background jobs, 0 for no limit
+ */
+int getMaxJobs() { return maxJobs; }
+
+/*
+ * Function: treatCommand
+ * ----------------------
+ *   Treat a given command, a command in background waits in the queue while
+ *   maxJobs background jobs are running
+ *
+ *   cmd: the command to treat
+ */
+void treatCommand(struct cmdline *cmd, proc_t *procList) {
+    if (!cmd->backgrounded || maxJobs == 0 || runningJobs() < maxJobs) {
+        launchCommand(cmd, procList, 0);
+        return;
+    }
+    char *jobName[jobNameWords(cmd)];
+    getJobName(cmd, jobName);
+    queuedJob *job = safe_malloc(sizeof(queuedJob));
+    job->id = addProcess(procList, 0, QUEUED, jobName);
+    job->cmd = dupcmd(cmd); // The command line is reused by the next readcmd
+    job->next = NULL;
+    if (queueTail != NULL) {
+        queueTail->next = job;
+    }
+    else {
+        queueHead = job;
+    }
+    queueTail = job;
+    printProcessByID(procList, job->id);
+}
+
+/*
+ * Function: waitChild
+ * -------------------
+ *   waitid, with the resources used by the child which the libc wrapper doesn't give
+ *
+ *   type: the children to wait for (P_ALL or P_PIDFD)
+ *   id: the pidfd of the child for P_PIDFD
+ *   options: the state changes to wait for (WEXITED, WSTOPPED, WCONTINUED), without blocking
+ *   status: set to the state change, encoded like the status given by wait4
+ *   usage: set to the resources used by the child, if it ended
+ *
+ *   Return: the PID of the child, 0 if no child changed state, -1 on error
+ */
+int waitChild(idtype_t type, id_t id, int options, int *status, struct rusage *usage) {
+    siginfo_t info;
+    info.si_pid = 0;
+    if (syscall(SYS_waitid, type, id, &info, options | WNOHANG, usage) < 0) {
+        return -1;
+    }
+    if (info.si_pid == 0) {
+        return 0;
+    }
+    switch (info.si_code) {
+    case CLD_EXITED:
+        *status = W_EXITCODE(info.si_status, 0);
+        break;
+    case CLD_KILLED:
+        *status = W_EXITCODE(0, info.si_status);
+        break;
+    case CLD_DUMPED:
+        *status = W_EXITCODE(0, info.si_status) | WCOREFLAG;
+        break;
+    case CLD_CONTINUED:
+        *status = 0xffff; // Tested by WIFCONTINUED
+        break;
+    default: // CLD_STOPPED, CLD_TRAPPED
+        *status = W_STOPCODE(info.si_status);
+    }
+    return info.si_pid;
+}
+
+/*
+ * Function: childEnded
+ * --------------------
+ *   Record the end of a reaped child, its job ends with its last process
+ *
+ *   childPID: the PID of the child
+ *   childState: the wait status of the child
+ *   usage: the resources used by the child
+ */
+void childEnded(int childPID, int childState, const struct rusage *usage) {
+    if (WIFEXITED(childState)) {
+        DEBUG_PRINTF("[%d] Child exited, status=%d\n", childPID, WEXITSTATUS(childState));
+    }
+    else {
+        DEBUG_PRINTF("[%d] Child killed by signal %d\n", childPID, WTERMSIG(childState));
+    }
+    TRACE(TRACE_REAP, childPID, childState, NULL);
+    // Every process of a job is found by its PID, the job by its process group
+    int pgid = getPID(procList, getID(procList, childPID));
+    addProcessUsage(procList, childPID, usage);
+    if (reapProcessByPID(procList, childPID, childState) != 0) {
+        return;
+    }
+    if (pgid == foregroundPID) {
+        DEBUG_PRINT("stopReceived=true\n");
+        stopReceived = true;
+        getProcessUsageByPID(procList, childPID, &foregroundUsage);
+        removeProcessByPID(procList, childPID);
+    }
+    else {
+        // Kept with its status until it is printed or waited for
+        setProcessStatusByPID(procList, childPID, DONE);
+    }
+}
+
+/*
+ * Function: exitHandler
+ * ---------------------
+ *   Called when the pidfd of a child is readable, once the child ended
+ *
+ *   fd: the pidfd
+ *   data: the childWatch of the child
+ */
+void exitHandler(int fd, void *data) {
+    uint64_t start = statsClock();
+    childWatch *watch = data;
+    int childState;
+    struct rusage usage;
+    // The pidfd designates this child only: its PID can't have been reused by another one
+    int childPID = waitChild(P_PIDFD, fd, WEXITED, &childState, &usage);
+    if (childPID == 0) {
+        return;
+    }
+    // ECHILD if it was reaped by childHandler, once the pidfds couldn't be used anymore
+    DEBUG_PRINTF("[%d] pidfd %d closed\n", watch->pid, fd);
+    removeEventSource(watch->source);
+    close(fd);
+    free(watch);
+    if (childPID > 0) {
+        childEnded(childPID, childState, &usage);
+        recordLatency(STAT_REAPING, start);
+        startQueuedJobs();
+    }
+}
+
+/*
+ * Function: watchChild
+ * --------------------
+ *   Watch the end of a child with a pidfd in the event loop
+ *
+ *   Notes: without pidfds (before Linux 5.4, or when no file descriptor is left),
+ *   childHandler reaps the children which ended as well
+ *
+ *   pid: the PID of the child, not reaped yet
+ */
+void watchChild(int pid) {
+    // A forked built-in command doesn't run the event loop of the shell
+    if (!pidfdEnabled || forkedBuiltin) {
+        return;
+    }
+    int fd = (int)syscall(SYS_pidfd_open, pid, 0); // Close-on-exec
+    if (fd < 0) {
+        DEBUG_PRINTF("pidfd_open: %s, the children are reaped on SIGCHLD\n", strerror(errno));
+        pidfdEnabled = false;
+        return;
+    }
+    childWatch *watch = safe_malloc(sizeof(childWatch));
+    watch->pid = pid;
+    watch->source = addEventSource(fd, exitHandler, watch);
 }
 
 /*
  * Function: childHandler
  * ----------------------
- *   Handle SIGCHLD
+ *   Handle SIGCHLD, find every child that stopped or resumed since the last call,
+ *   the ends are reported by the pidfds (see watchChild)
  */
 void childHandler() {
     DEBUG_PRINT("childHandler received a signal\n");
+    int options = WSTOPPED | WCONTINUED;
+    if (!pidfdEnabled || forkedBuiltin) {
+        options |= WEXITED;
+    }
     int childState, childPID;
-    do {
-        childPID = (int)waitpid(-1, &childState, WNOHANG | WUNTRACED | WCONTINUED);
-        if ((childPID == -1) && (errno != ECHILD)) {
-            perror("waitpid");
-            exit(EXIT_FAILURE);
-        }
-        else if (childPID > 0) {
-            if (WIFSTOPPED(childState)) {
-                DEBUG_PRINTF("[%d] Child stopped by signal %d\n", childPID, WSTOPSIG(childState));
-                if (childPID == foregroundPID) {
-                    DEBUG_PRINT("stopReceived=true\n");
-                    stopReceived = true;
-                    // Add the process to the list if it is not already present in the list
-                    if (getProcessStatusByPID(procList, foregroundPID) == UNDEFINED) {
-                        addProcess(procList, foregroundPID, SUSPENDED, cmd->seq[0]);
-                    }
-                    setProcessStatusByPID(procList, childPID, SUSPENDED);
+    struct rusage usage;
+    uint64_t start = statsClock();
+    for (; (childPID = waitChild(P_ALL, 0, options, &childState, &usage)) > 0; start = statsClock()) {
+        int pgid = getPID(procList, getID(procList, childPID));
+        if (WIFSTOPPED(childState)) {
+            DEBUG_PRINTF("[%d] Child stopped by signal %d\n", childPID, WSTOPSIG(childState));
+            TRACE(TRACE_STOP, childPID, WSTOPSIG(childState), NULL);
+            // The first stopped process stops the job, the others were signaled with it
+            if (getProcessStatusByPID(procList, childPID) == ACTIVE) {
+                setProcessStatusByPID(procList, childPID, SUSPENDED);
+                if (pgid == foregroundPID) {
                     printProcessByPID(procList, childPID);
                 }
             }
-            else if (WIFCONTINUED(childState)) {
-                DEBUG_PRINTF("[%d] Child resumed\n", childPID);
-                setProcessStatusByPID(procList, childPID, ACTIVE);
-            }
-            else if (WIFEXITED(childState)) {
-                DEBUG_PRINTF("[%d] Child exited, status=%d\n", childPID, WEXITSTATUS(childState));
-                if (childPID == foregroundPID) {
-                    DEBUG_PRINT("stopReceived=true\n");
-                    stopReceived = true;
-                    removeProcessByPID(procList, childPID);
-                }
-                else {
-                    setProcessStatusByPID(procList, childPID, DONE);
-                }
+            if (pgid == foregroundPID) {
+                DEBUG_PRINT("stopReceived=true\n");
+                stopReceived = true;
+                getProcessUsageByPID(procList, childPID, &foregroundUsage);
             }
-            else if (WIFSIGNALED(childState)) {
-                DEBUG_PRINTF("[%d] Child killed by signal %d\n", childPID, WTERMSIG(childState));
-                if (childPID == foregroundPID) {
-                    DEBUG_PRINT("stopReceived=true\n");
-                    stopReceived = true;
-                }
-                else {
-                    removeProcessByPID(procList, childPID);
-                }
+        }
+        else if (WIFCONTINUED(childState)) {
+            DEBUG_PRINTF("[%d] Child resumed\n", childPID);
+            TRACE(TRACE_CONTINUE, childPID, 0, NULL);
+            if (getProcessStatusByPID(procList, childPID) == SUSPENDED) {
+                setProcessStatusByPID(procList, childPID, ACTIVE);
             }
         }
-    } while (childPID > 0);
+        else {
+            childEnded(childPID, childState, &usage);
+            recordLatency(STAT_REAPING, start);
+        }
+    }
+    if (childPID < 0 && errno != ECHILD) {
+        perror("waitid");
+        exit(EXIT_FAILURE);
+    }
+    // The jobs which ended or stopped leave room for the queued ones
+    startQueuedJobs();
 }
 
 /*
@@ -244,12 +898,12 @@ void stopHandler() {
         return;
     }
     state status = getProcessStatusByPID(procList, foregroundPID);
-    if (status == SUSPENDED) { // Process already stopped
-        DEBUG_PRINTF("Stop signal received, but process %d is already suspended\n", foregroundPID);
+    if (status == SUSPENDED) { // Job already stopped
+        DEBUG_PRINTF("Stop signal received, but job %d is already suspended\n", foregroundPID);
         return;
     }
-    DEBUG_PRINTF("Stop signal received, stopping foreground process %d\n", foregroundPID);
-    kill(foregroundPID, SIGSTOP);
+    DEBUG_PRINTF("Stop signal received, stopping foreground job %d\n", foregroundPID);
+    killpg(foregroundPID, SIGSTOP);
 }
 
 /*
@@ -259,48 +913,215 @@ void stopHandler() {
  */
 void sigintHandler() {
     if (foregroundPID == 0) {
-        DEBUG_PRINT("Process 0 can't be interrupted\n");
+        DEBUG_PRINT("No foreground job, interrupting the built-in command\n");
+        interruptReceived = true;
         return;
     }
-    DEBUG_PRINTF("SIGINT received, interrupting foreground process %d\n", foregroundPID);
-    kill(foregroundPID, SIGKILL);
-    stopReceived = true;
+    DEBUG_PRINTF("SIGINT received, interrupting foreground job %d\n", foregroundPID);
+    // The job is removed when its last process is reaped
+    killpg(foregroundPID, SIGKILL);
+}
+
+/*
+ * Function: mapScript
+ * -------------------
+ *   Map a script in memory and give it to readcmd, exit if it can't be opened
+ *
+ *   path: the path of the script
+ */
+void mapScript(const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        printf("minishell: %s: No such file or directory\n", path);
+        exit(127);
+    }
+    // readcmd terminates the lines in place: map the file privately, followed by at least
+    // one zeroed byte for the last line
+    size_t size = st.st_size;
+    size_t pageSize = sysconf(_SC_PAGESIZE);
+    char *script = mmap(NULL, (size / pageSize + 1) * pageSize, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (script == MAP_FAILED ||
+        (size > 0 &&
+         mmap(script, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED)) {
+        perror("mmap");
+        exit(EXIT_FAILURE);
+    }
+    close(fd);
+    readcmd_from(script, size);
+}
+
+/*
+ * Function: signalHandler
+ * -----------------------
+ *   Read the pending signals from the signalfd and handle them
+ *
+ *   fd: the signalfd
+ *   data: unused
+ */
+void signalHandler(int fd, void *data) {
+    (void)data;
+    struct signalfd_siginfo info[16];
+    ssize_t n;
+    bool childChanged = false;
+    while ((n = read(fd, info, sizeof(info))) > 0) {
+        for (size_t i = 0; i < (size_t)n / sizeof(struct signalfd_siginfo); i++) {
+            TRACE(TRACE_SIGNAL, info[i].ssi_pid, info[i].ssi_signo, NULL);
+            switch (info[i].ssi_signo) {
+            case SIGCHLD:
+                childChanged = true; // Reap once for the whole batch
+                break;
+            case SIGTSTP:
+                stopHandler();
+                break;
+            case SIGINT:
+                sigintHandler();
+                break;
+            }
+        }
+    }
+    if (n < 0 && errno != EAGAIN) {
+        perror("read signalfd");
+        exit(EXIT_FAILURE);
+    }
+    if (childChanged) {
+        childHandler();
+    }
 }
 
-int main() {
-    // Associate signals to their handlers
-    struct sigaction sa;
-    sa.sa_handler = childHandler;
-    sa.sa_flags = SA_RESTART;
-    sigemptyset(&sa.sa_mask);
-    sigaction(SIGCHLD, &sa, 0);
+/*
+ * Function: inputHandler
+ * ----------------------
+ *   Called when a command line can be read from standard input
+ *
+ *   fd: the standard input
+ *   data: unused
+ */
+void inputHandler(int fd, void *data) {
+    (void)fd;
+    (void)data;
+    inputReady = true;
+}
 
-    sa.sa_handler = stopHandler;
-    sigaction(SIGTSTP, &sa, 0);
+int main(int argc, char **argv) {
+    // Commands are read from standard input, from a string (-c) or from a script
+    bool fromStdin = true;
+    if (argc == 2 && !strcmp(argv[1], "-c")) {
+        printf("minishell: -c: option requires an argument\n");
+        printf("Usage: minishell [-c command | script]\n");
+        exit(2);
+    }
+    if (argc >= 3 && !strcmp(argv[1], "-c")) {
+        readcmd_from(argv[2], strlen(argv[2]));
+        fromStdin = false;
+    }
+    else if (argc >= 2) {
+        mapScript(argv[1]);
+        fromStdin = false;
+    }
+    // Batch mode: no prompt if the commands don't come from a terminal
+    interactive = fromStdin && isatty(STDIN_FILENO);
 
-    sa.sa_handler = sigintHandler;
-    sigaction(SIGINT, &sa, 0);
+    // Block the signals handled by the shell, they are read from a signalfd by the event loop
+    // so that the process list is never modified from a signal handler
+    sigset_t handledSignals;
+    sigemptyset(&handledSignals);
+    sigaddset(&handledSignals, SIGCHLD);
+    sigaddset(&handledSignals, SIGTSTP);
+    sigaddset(&handledSignals, SIGINT);
+    sigprocmask(SIG_BLOCK, &handledSignals, &originalMask);
+    int signalFD = signalfd(-1, &handledSignals, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signalFD < 0) {
+        perror("signalfd");
+        exit(EXIT_FAILURE);
+    }
+    // A built-in command writing to a pipe whose reader exited gets EPIPE instead of killing
+    // the shell, and the shell can give the terminal back to itself from the background.
+    // The children get back the original mask
+    sigset_t blockedSignals;
+    sigemptyset(&blockedSignals);
+    sigaddset(&blockedSignals, SIGPIPE);
+    sigaddset(&blockedSignals, SIGTTOU);
+    sigaddset(&blockedSignals, SIGTTIN);
+    sigprocmask(SIG_BLOCK, &blockedSignals, NULL);
+
+    // The shell leads its own process group, which owns the terminal between the jobs
+    if (interactive) {
+        setpgid(0, 0);
+        tcsetpgrp(STDIN_FILENO, getpgrp());
+    }
+
+    initEventLoop();
+    addEventSource(signalFD, signalHandler, NULL);
+    // NULL if standard input is a regular file, which is always ready
+    eventSource *input = NULL;
+    if (fromStdin) {
+        input = addEventSource(STDIN_FILENO, inputHandler, NULL);
+    }
+    if (input != NULL) {
+        enableEventSource(input, false);
+    }
+
+    // Record the events of the shell until it exits
+    const char *tracePath = getenv("MINISHELL_TRACE");
+    if (tracePath != NULL && *tracePath != '\0') {
+        traceAtExit(tracePath);
+    }
+
+    // Capacity of the pipes between the commands, also set by the pipesize built-in command
+    const char *pipeSize = getenv("MINISHELL_PIPESIZE");
+    if (pipeSize != NULL) {
+        int size = parsePipeSize(pipeSize);
+        if (size < 0 || setPipeSize(size) < 0) {
+            printf("minishell: MINISHELL_PIPESIZE: %s: invalid size\n", pipeSize);
+        }
+    }
 
     // Create the process list
     procList = initProcList();
 
+    // Maximum number of running background jobs, also set by the maxjobs built-in command
+    const char *jobLimit = getenv("MINISHELL_MAXJOBS");
+    if (jobLimit != NULL) {
+        char *end;
+        long max = strtol(jobLimit, &end, 10);
+        if (*jobLimit == '\0' || *end != '\0' || max > INT_MAX || setMaxJobs(max) < 0) {
+            printf("minishell: MINISHELL_MAXJOBS: %s: invalid number\n", jobLimit);
+        }
+    }
+
     // Main loop
     while (true) {
-        // Show the prompt
-        printf(PS1, getenv("USER"), getenv("PWD"));
+        if (interactive) {
+            // Show the prompt
+            printf(PS1, getenv("USER"), getenv("PWD"));
 
-        // Flush output buffer
-        fflush(stdout);
+            // Flush output buffer
+            fflush(stdout);
+        }
+
+        // Handle job events until a command line is available
+        if (input != NULL && !readcmd_ready()) {
+            inputReady = false;
+            enableEventSource(input, true);
+            while (!inputReady) {
+                runEventLoopOnce();
+            }
+            enableEventSource(input, false);
+        }
 
         // Read a command from standard input and execute it
+        uint64_t parseStart = statsClock();
         cmd = readcmd();
+        recordLatency(STAT_PARSE, parseStart);
 
         // Print terminated processes and delete them from the list
         updateProcList(procList);
 
         if (cmd == NULL) { // Exit if CTRL+D is pressed to avoid an infinite loop
             DEBUG_PRINT("CTRL+D entered, exiting ...\n");
-            exitShell(procList);
+            exitShell(NULL, STDIN_FILENO, STDOUT_FILENO, procList);
         }
         else if (cmd->seq == NULL || *(cmd->seq) == NULL) { // Handle empty line
             DEBUG_PRINT("Empty line entered\n");
@@ -308,7 +1129,15 @@ int main() {
         else {
             // Treat the command
             DEBUG_PRINTF("Treating command '%s'\n", cmd->seq[0][0]);
+            int stages = 0;
+            while (cmd->seq[stages] != NULL) {
+                stages++;
+            }
+            TRACE(TRACE_COMMAND_BEGIN, 0, stages, cmd->seq[0][0]);
+            uint64_t commandStart = statsClock();
             treatCommand(cmd, procList);
+            recordLatency(STAT_COMMAND, commandStart);
+            TRACE(TRACE_COMMAND_END, 0, 0, NULL);
         }
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,390 @@
+#define _GNU_SOURCE // memfd_create, sched_getaffinity
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "parallel.h"
+#include "proclist.h"
+#include "shell.h"
+
+// Size of the first buffer of the argument lines, doubled for longer lines
+#define LINE_BUFFER_SIZE 4096
+
+// Highest exit status of parallel, whatever the number of failed tasks
+#define MAX_FAILED 101
+
+// Lines read from a file descriptor, in a buffer reused from one line to the next
+typedef struct lineReader {
+    int fd;        // The file descriptor
+    char *buffer;  // The bytes read and not returned yet, from start to end
+    size_t size;   // Size of buffer
+    size_t start;  // Beginning of the next line
+    size_t end;    // End of the bytes read
+    bool finished; // End of file reached ?
+} lineReader;
+
+// A command run for a line
+typedef struct task {
+    int pid;    // PID of the process, 0 once it was reaped (or couldn't be created)
+    int output; // Temporary file with the output of the process (-k), -1 otherwise
+    int status; // Wait status of the process
+    char *line; // The line given to the command
+} task;
+
+// State of a parallel command
+typedef struct parallelRun {
+    char **command; // Arguments of the command, {} is replaced by the line
+    int jobs;       // Maximum number of running tasks
+    bool keepOrder; // Write the outputs in the order of the lines ?
+    int input;      // Input of the tasks
+    int out;        // Output of the tasks (and of parallel)
+    int pgid;       // Process group of the tasks, 0 for a group per task
+    task *tasks;    // Tasks running, or whose output waits for an earlier task (-k)
+    size_t first;   // First task whose output wasn't written
+    size_t count;   // End of the tasks
+    size_t capacity; // Size of tasks
+    int running;    // Number of tasks not reaped yet
+    int failed;     // Number of tasks which failed
+} parallelRun;
+
+// Get the next line (without its newline), NULL at the end of the input
+static char *nextLine(lineReader *reader) {
+    while (true) {
+        char *line = reader->buffer + reader->start;
+        char *newline = memchr(line, '\n', reader->end - reader->start);
+        if (newline != NULL) {
+            *newline = '\0';
+            reader->start = newline + 1 - reader->buffer;
+            return line;
+        }
+        if (reader->finished) { // Last line without a newline
+            if (reader->start == reader->end) {
+                return NULL;
+            }
+            reader->buffer[reader->end] = '\0';
+            reader->start = reader->end;
+            return line;
+        }
+        // Keep the beginning of the line at the start of the buffer, with room for a '\0'
+        memmove(reader->buffer, line, reader->end - reader->start);
+        reader->end -= reader->start;
+        reader->start = 0;
+        if (reader->end + 1 == reader->size) {
+            char *buffer = safe_malloc(2 * reader->size);
+            memcpy(buffer, reader->buffer, reader->end);
+            free(reader->buffer);
+            reader->buffer = buffer;
+            reader->size *= 2;
+        }
+        ssize_t n = read(reader->fd, reader->buffer + reader->end, reader->size - reader->end - 1);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            fprintf(stderr, "minishell: parallel: %s\n", strerror(errno));
+        }
+        if (n <= 0) {
+            reader->finished = true;
+        }
+        else {
+            reader->end += n;
+        }
+    }
+}
+
+// Copy a word with each {} replaced by the line
+static char *substitute(const char *word, const char *line) {
+    size_t count = 0;
+    for (const char *s = strstr(word, "{}"); s != NULL; s = strstr(s + 2, "{}")) {
+        count++;
+    }
+    size_t lineLength = strlen(line);
+    char *result = safe_malloc(strlen(word) + count * lineLength - 2 * count + 1);
+    char *end = result;
+    for (const char *s; (s = strstr(word, "{}")) != NULL; word = s + 2) {
+        memcpy(end, word, s - word);
+        end += s - word;
+        memcpy(end, line, lineLength);
+        end += lineLength;
+    }
+    strcpy(end, word);
+    return result;
+}
+
+// Arguments of the command for a line, to be freed with freeTaskArguments
+static char **taskArguments(char **command, char *line) {
+    size_t argc = 0;
+    bool substituted = false;
+    for (; command[argc] != NULL; argc++) {
+        substituted = substituted || strstr(command[argc], "{}") != NULL;
+    }
+    char **argv = safe_malloc((argc + 2) * sizeof(char *));
+    for (size_t i = 0; i < argc; i++) {
+        argv[i] = strstr(command[i], "{}") != NULL ? substitute(command[i], line) : command[i];
+    }
+    if (!substituted) {
+        argv[argc++] = line;
+    }
+    argv[argc] = NULL;
+    return argv;
+}
+
+static void freeTaskArguments(char **command, char **argv) {
+    for (size_t i = 0; command[i] != NULL; i++) {
+        if (argv[i] != command[i]) {
+            free(argv[i]);
+        }
+    }
+    free(argv);
+}
+
+// Report a task which failed
+static void reportTask(parallelRun *run, const task *t) {
+    if (WIFEXITED(t->status) && WEXITSTATUS(t->status) == 0) {
+        return;
+    }
+    run->failed++;
+    if (WIFSIGNALED(t->status)) {
+        fprintf(stderr, "minishell: parallel: %s: %s\n", t->line, strsignal(WTERMSIG(t->status)));
+    }
+    else {
+        fprintf(stderr, "minishell: parallel: %s: exit status %d\n", t->line,
+                WEXITSTATUS(t->status));
+    }
+}
+
+// Start the command for a line, as a new job of the process list
+static void startTask(parallelRun *run, proc_t *procList, char *line) {
+    if (run->count == run->capacity) { // There is room before first, the tasks are fewer
+        memmove(run->tasks, run->tasks + run->first, (run->count - run->first) * sizeof(task));
+        run->count -= run->first;
+        run->first = 0;
+    }
+    task *t = &run->tasks[run->count++];
+    size_t length = strlen(line);
+    t->line = safe_malloc(length + 1);
+    memcpy(t->line, line, length + 1);
+    t->pid = 0;
+    t->status = 127 << 8; // Like a shell which couldn't run the command
+    t->output = -1;
+    if (run->keepOrder) {
+        t->output = memfd_create("parallel", MFD_CLOEXEC);
+        if (t->output < 0) {
+            fprintf(stderr, "minishell: parallel: %s\n", strerror(errno));
+            reportTask(run, t);
+            return;
+        }
+    }
+    char **argv = taskArguments(run->command, t->line);
+    t->pid = execExternalCommand(run->input, run->keepOrder ? t->output : run->out, argv,
+                                 run->pgid);
+    if (t->pid > 0) {
+        addProcess(procList, t->pid, ACTIVE, argv);
+        run->running++;
+    }
+    else {
+        t->pid = 0;
+        reportTask(run, t);
+        if (!run->keepOrder) {
+            free(t->line);
+            run->count--;
+        }
+    }
+    freeTaskArguments(run->command, argv);
+}
+
+// Collect the status of the tasks reaped by the shell
+static void collectTasks(parallelRun *run, proc_t *procList) {
+    // Backwards, so that a finished task can be replaced by the last one
+    for (size_t i = run->count; i-- > run->first;) {
+        task *t = &run->tasks[i];
+        if (t->pid == 0 || getProcessStatusByPID(procList, t->pid) != DONE) {
+            continue;
+        }
+        t->status = getProcessExitStatusByPID(procList, t->pid);
+        removeProcessByPID(procList, t->pid);
+        t->pid = 0;
+        run->running--;
+        reportTask(run, t);
+        if (!run->keepOrder) {
+            free(t->line);
+            *t = run->tasks[--run->count];
+        }
+    }
+}
+
+// Copy a block of a file at offset to out with read and write, return its size or -1
+static ssize_t copyBlock(int file, int out, off_t offset) {
+    static char buffer[1 << 16];
+    ssize_t n = pread(file, buffer, sizeof(buffer), offset);
+    for (ssize_t written = 0; written < n;) {
+        ssize_t w = write(out, buffer + written, n - written);
+        if (w < 0) {
+            return -1;
+        }
+        written += w;
+    }
+    return n;
+}
+
+// Write the output of a task, kept in a temporary file
+static void writeOutput(int file, int out) {
+    off_t size = lseek(file, 0, SEEK_END);
+    off_t offset = 0;
+    bool copy = false; // sendfile can't write to out (e.g. a file in append mode) ?
+    while (offset < size) {
+        ssize_t n;
+        if (!copy) {
+            n = sendfile(out, file, &offset, size - offset);
+            if (n < 0 && (errno == EINVAL || errno == ENOSYS)) {
+                copy = true;
+                continue;
+            }
+        }
+        else if ((n = copyBlock(file, out, offset)) > 0) {
+            offset += n;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            // A closed reader ends the output silently, like the SIGPIPE of the tasks
+            if (n < 0 && errno != EPIPE) {
+                fprintf(stderr, "minishell: parallel: %s\n", strerror(errno));
+            }
+            return;
+        }
+    }
+}
+
+// Write the outputs of the finished tasks which don't wait for an earlier task
+static void flushTasks(parallelRun *run) {
+    while (run->first < run->count && run->tasks[run->first].pid == 0) {
+        task *t = &run->tasks[run->first++];
+        if (t->output >= 0) {
+            writeOutput(t->output, run->out);
+            close(t->output);
+        }
+        free(t->line);
+    }
+    if (run->first == run->count) {
+        run->first = run->count = 0;
+    }
+}
+
+// Number of processors the shell may run on
+static int processorCount() {
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        return CPU_COUNT(&set);
+    }
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? count : 1;
+}
+
+int parallel(char **argv, int in, int out, proc_t *procList) {
+    DEBUG_PRINT("Executing built-in command 'parallel'\n");
+    parallelRun run = {.jobs = processorCount(), .out = out, .input = -1};
+    const char *file = NULL;
+    char **arg = argv + 1;
+    for (; *arg != NULL && (*arg)[0] == '-'; arg++) {
+        if (!strcmp(*arg, "--")) {
+            arg++;
+            break;
+        }
+        else if (!strcmp(*arg, "-k")) {
+            run.keepOrder = true;
+        }
+        else if (!strcmp(*arg, "-j") && arg[1] != NULL) {
+            char *end;
+            long jobs = strtol(*++arg, &end, 10);
+            if (*end != '\0' || jobs < 1 || jobs > 65536) {
+                fprintf(stderr, "minishell: parallel: %s: invalid number of jobs\n", *arg);
+                return 1;
+            }
+            run.jobs = jobs;
+        }
+        else if (!strcmp(*arg, "-a") && arg[1] != NULL) {
+            file = *++arg;
+        }
+        else {
+            break;
+        }
+    }
+    if (*arg == NULL || (*arg)[0] == '-') {
+        fprintf(stderr,
+                "minishell: parallel: usage: parallel [-j jobs] [-k] [-a file] command [args]\n");
+        return 1;
+    }
+    run.command = arg;
+
+    lineReader reader = {.fd = in, .size = LINE_BUFFER_SIZE};
+    if (file != NULL && (reader.fd = open(file, O_RDONLY | O_CLOEXEC)) < 0) {
+        fprintf(stderr, "minishell: parallel: %s: %s\n", file, strerror(errno));
+        return 1;
+    }
+    // The lines are read from the input, the tasks don't share it
+    run.input = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    if (run.input < 0) {
+        perror("open");
+        exit(EXIT_FAILURE);
+    }
+    reader.buffer = safe_malloc(reader.size);
+    run.capacity = run.keepOrder ? (size_t)run.jobs * PARALLEL_WINDOW : (size_t)run.jobs;
+    run.tasks = safe_malloc(run.capacity * sizeof(task));
+    // A forked parallel keeps its tasks in its group, which gets the signals of the terminal
+    run.pgid = forkedBuiltin ? getpgrp() : 0;
+    fflush(stdout); // The tasks write directly to out, after the previous output
+    interruptReceived = false;
+
+    bool finished = false;    // No other task to start ?
+    bool interrupted = false; // Running tasks terminated by CTRL+C ?
+    while (true) {
+        while (!finished && run.running < run.jobs && run.count - run.first < run.capacity) {
+            char *line = nextLine(&reader);
+            if (line == NULL) {
+                finished = true;
+                break;
+            }
+            startTask(&run, procList, line);
+        }
+        flushTasks(&run);
+        if (run.running == 0) {
+            if (finished) {
+                break;
+            }
+            continue;
+        }
+        handleEvents();
+        if (interruptReceived && !interrupted) {
+            DEBUG_PRINT("Interrupted, terminating the running tasks\n");
+            finished = interrupted = true;
+            for (size_t i = run.first; i < run.count; i++) {
+                if (run.tasks[i].pid != 0) {
+                    run.pgid == 0 ? killpg(run.tasks[i].pid, SIGTERM)
+                                  : kill(run.tasks[i].pid, SIGTERM);
+                }
+            }
+        }
+        collectTasks(&run, procList);
+    }
+
+    if (reader.fd != in) {
+        close(reader.fd);
+    }
+    close(run.input);
+    free(reader.buffer);
+    free(run.tasks);
+    return run.failed < MAX_FAILED ? run.failed : MAX_FAILED;
+}
@@ -0,0 +1,38 @@
+/*
+ * Built-in command running a command once per line of its input, several at a time
+ *
+ * The tasks are jobs of the process list, they are reaped by the event loop of the
+ * shell like the other jobs and reported on the standard error when they fail.
+ */
+
+#ifndef __PARALLEL_H
+#define __PARALLEL_H
+
+#include "proclist.h"
+
+// With -k, number of tasks per concurrent task which may have ended and still wait for an
+// earlier one to write their output (each one keeps its output in a temporary file)
+#ifndef PARALLEL_WINDOW
+#define PARALLEL_WINDOW 16
+#endif
+
+/*
+ * Function: parallel
+ * ------------------
+ *   Run a command for each line read from the input (or from the file given with -a),
+ *   with at most the number given with -j running at the same time (by default the
+ *   number of processors the shell may run on). Each {} in the arguments is replaced by
+ *   the line, the line is added as the last argument if there is none.
+ *
+ *   Example:
+ *     ls *.c | parallel -j 4 -k gcc -c {}
+ *
+ *   Notes: the tasks write directly to the output as they run, with -k their output is
+ *   kept until every earlier task has written its own, so that it comes in the order of
+ *   the lines. CTRL+C terminates the running tasks and starts no other one.
+ *
+ *   Return: the number of tasks which failed (at most 101)
+ */
+int parallel(char **argv, int in, int out, proc_t *procList);
+
+#endif
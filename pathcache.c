@@ -0,0 +1,150 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "pathcache.h"
+
+// Number of buckets of the hash table
+#define CACHE_SIZE 64
+
+typedef struct cachedCommand {
+    char *name;                 // Name of the command
+    char *path;                 // File executed for this command
+    int hits;                   // Number of times the command was looked up
+    struct cachedCommand *next; // Next command in the same bucket
+} cachedCommand;
+
+static cachedCommand *cache[CACHE_SIZE];
+static char *cachedPATH = NULL; // Value of PATH when the cache was filled
+
+// FNV-1a hash of a command name
+static unsigned int hashName(const char *name) {
+    uint32_t h = 2166136261u;
+    for (const unsigned char *c = (const unsigned char *)name; *c != '\0'; c++) {
+        h = (h ^ *c) * 16777619u;
+    }
+    return h % CACHE_SIZE;
+}
+
+// Is path an executable regular file ?
+static int isExecutable(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISREG(st.st_mode) && access(path, X_OK) == 0;
+}
+
+// Look for name in each directory of PATH, return a newly allocated path or NULL
+static char *searchPATH(const char *name, const char *PATH) {
+    size_t nameLength = strlen(name);
+    const char *dir = PATH;
+    while (dir != NULL) {
+        const char *end = strchr(dir, ':');
+        size_t dirLength = end != NULL ? (size_t)(end - dir) : strlen(dir);
+        char *path = safe_malloc(dirLength + nameLength + 3);
+        if (dirLength == 0) { // An empty entry is the current directory
+            path[0] = '.';
+            dirLength = 1;
+        }
+        else {
+            memcpy(path, dir, dirLength);
+        }
+        path[dirLength] = '/';
+        memcpy(path + dirLength + 1, name, nameLength + 1);
+        if (isExecutable(path)) {
+            return path;
+        }
+        free(path);
+        dir = end != NULL ? end + 1 : NULL;
+    }
+    return NULL;
+}
+
+const char *findCommand(const char *name) {
+    if (strchr(name, '/') != NULL) {
+        return name;
+    }
+
+    // Forget everything if PATH was modified since the cache was filled
+    const char *PATH = getenv("PATH");
+    if (PATH == NULL) {
+        PATH = "/usr/local/bin:/usr/bin:/bin";
+    }
+    if (cachedPATH == NULL || strcmp(cachedPATH, PATH) != 0) {
+        DEBUG_PRINT("PATH changed, clearing the command cache\n");
+        clearCommandCache();
+        free(cachedPATH);
+        cachedPATH = strdup(PATH);
+    }
+
+    unsigned int h = hashName(name);
+    for (cachedCommand *current = cache[h]; current != NULL; current = current->next) {
+        if (!strcmp(current->name, name)) {
+            current->hits++;
+            return current->path;
+        }
+    }
+
+    char *path = searchPATH(name, PATH);
+    if (path == NULL) {
+        DEBUG_PRINTF("Command %s not found in PATH\n", name);
+        return NULL;
+    }
+    DEBUG_PRINTF("Command %s found at %s\n", name, path);
+    cachedCommand *new = safe_malloc(sizeof(cachedCommand));
+    new->name = strdup(name);
+    new->path = path;
+    new->hits = 1;
+    new->next = cache[h];
+    cache[h] = new;
+    return path;
+}
+
+void forgetCommand(const char *name) {
+    cachedCommand **prev = &cache[hashName(name)];
+    while (*prev != NULL) {
+        cachedCommand *current = *prev;
+        if (!strcmp(current->name, name)) {
+            *prev = current->next;
+            free(current->name);
+            free(current->path);
+            free(current);
+            DEBUG_PRINTF("Command %s removed from the cache\n", name);
+            return;
+        }
+        prev = &current->next;
+    }
+}
+
+void clearCommandCache() {
+    for (int i = 0; i < CACHE_SIZE; i++) {
+        cachedCommand *current = cache[i];
+        while (current != NULL) {
+            cachedCommand *next = current->next;
+            free(current->name);
+            free(current->path);
+            free(current);
+            current = next;
+        }
+        cache[i] = NULL;
+    }
+}
+
+void printCommandCache() {
+    bool empty = true;
+    for (int i = 0; i < CACHE_SIZE; i++) {
+        for (cachedCommand *current = cache[i]; current != NULL; current = current->next) {
+            if (empty) {
+                printf("hits\tcommand\n");
+                empty = false;
+            }
+            printf("%4d\t%s\n", current->hits, current->path);
+        }
+    }
+    if (empty) {
+        printf("minishell: hash table empty\n");
+    }
+}
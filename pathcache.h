@@ -0,0 +1,50 @@
+/*
+ * Cache of the location of the commands found in PATH
+ */
+
+#ifndef __PATHCACHE_H
+#define __PATHCACHE_H
+
+/*
+ * Function: findCommand
+ * ---------------------
+ *   Get the file executed for a command, looking for it in PATH only if it is
+ *   not already in the cache. The cache is cleared when PATH changes.
+ *
+ *   Notes: a name containing a '/' is returned as is and never cached
+ *
+ *   name: the name of the command
+ *
+ *   Return: the path of the file to execute (owned by the cache), or NULL if not found
+ */
+const char *findCommand(const char *name);
+
+/*
+ * Function: forgetCommand
+ * -----------------------
+ *   Remove a command from the cache, if it is not present the function does nothing
+ *
+ *   name: the name of the command
+ */
+void forgetCommand(const char *name);
+
+/*
+ * Function: clearCommandCache
+ * ---------------------------
+ *   Remove every command from the cache
+ */
+void clearCommandCache();
+
+/*
+ * Function: printCommandCache
+ * ---------------------------
+ *   Print the cached commands and the number of times they were used
+ *
+ *   Example:
+ *     hits	command
+ *        3	/usr/bin/ls
+ *        1	/usr/bin/sleep
+ */
+void printCommandCache();
+
+#endif
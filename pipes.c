@@ -0,0 +1,89 @@
+#define _GNU_SOURCE // F_SETPIPE_SZ, pipe2
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "pipes.h"
+
+static int pipeSize = 0;      // Capacity requested for the next pipes (0 for the default)
+static int effectiveSize = 0; // Capacity given by the kernel to the last pipe, 0 if unknown
+
+int openPipe(int fd[2]) {
+    // Close-on-exec: the children only keep the ends given to them by dup2
+    if (pipe2(fd, O_CLOEXEC) < 0) {
+        return -1;
+    }
+    if (pipeSize > 0 && fcntl(fd[1], F_SETPIPE_SZ, pipeSize) < 0) {
+        // The pipes of the user may exceed their quota (pipe-user-pages-soft), keep the default
+        DEBUG_PRINTF("F_SETPIPE_SZ %d failed\n", pipeSize);
+    }
+    return 0;
+}
+
+int maxPipeSize() {
+    int max = 1 << 20; // Default of Linux
+    FILE *f = fopen("/proc/sys/fs/pipe-max-size", "r");
+    if (f != NULL) {
+        if (fscanf(f, "%d", &max) != 1) {
+            max = 1 << 20;
+        }
+        fclose(f);
+    }
+    return max;
+}
+
+int setPipeSize(int size) {
+    if (size < 0) {
+        return -1;
+    }
+    int max = maxPipeSize();
+    if (size > max) {
+        DEBUG_PRINTF("Pipe size %d lowered to %d\n", size, max);
+        size = max;
+    }
+    pipeSize = size;
+    effectiveSize = 0;
+    return getPipeSize();
+}
+
+int parsePipeSize(const char *text) {
+    if (!strcmp(text, "default")) {
+        return 0;
+    }
+    char *end;
+    long size = strtol(text, &end, 10);
+    int shift = 0;
+    if (*end == 'k' || *end == 'K') {
+        shift = 10;
+        end++;
+    }
+    else if (*end == 'm' || *end == 'M') {
+        shift = 20;
+        end++;
+    }
+    // Checked before the shift, which could overflow
+    if (end == text || *end != '\0' || size < 0 || size > (INT_MAX >> shift)) {
+        return -1;
+    }
+    return size << shift;
+}
+
+int getPipeSize() {
+    // Measure the rounding of the kernel on a pipe created for it, once per setting
+    if (effectiveSize == 0) {
+        int fd[2];
+        if (openPipe(fd) < 0) {
+            return -1;
+        }
+        effectiveSize = fcntl(fd[1], F_GETPIPE_SZ);
+        close(fd[0]);
+        close(fd[1]);
+    }
+    return effectiveSize;
+}
@@ -0,0 +1,56 @@
+/*
+ * Pipes between the stages of a pipeline, with a configurable capacity
+ */
+
+#ifndef __PIPES_H
+#define __PIPES_H
+
+/*
+ * Function: openPipe
+ * ------------------
+ *   Create a close-on-exec pipe with the capacity set by setPipeSize
+ *
+ *   fd: the read and write ends of the pipe
+ *
+ *   Return: 0 on success, -1 if the pipe couldn't be created (errno is set)
+ */
+int openPipe(int fd[2]);
+
+/*
+ * Function: setPipeSize
+ * ---------------------
+ *   Set the capacity of the next pipes, rounded up by the kernel to a power of two
+ *   number of pages. A size above the maximum allowed to the user is lowered to it.
+ *
+ *   size: the capacity in bytes, 0 for the default capacity of the system
+ *
+ *   Return: the capacity of the next pipes, -1 if size is invalid
+ */
+int setPipeSize(int size);
+
+/*
+ * Function: parsePipeSize
+ * -----------------------
+ *   Read a pipe capacity in bytes, optionally followed by K or M
+ *
+ *   text: the capacity, "default" for the default capacity of the system
+ *
+ *   Return: the capacity in bytes (0 for the default), -1 if text is not a capacity
+ */
+int parsePipeSize(const char *text);
+
+/*
+ * Function: getPipeSize
+ * ---------------------
+ *   Return: the capacity of the next pipes, as created by the kernel
+ */
+int getPipeSize();
+
+/*
+ * Function: maxPipeSize
+ * ---------------------
+ *   Return: the largest capacity allowed to unprivileged users (/proc/sys/fs/pipe-max-size)
+ */
+int maxPipeSize();
+
+#endif
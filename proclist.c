@@ -1,107 +1,489 @@
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/wait.h>
 
 #include "debug.h"
 #include "proclist.h"
 
-// Maximum size of a command line to keep in the process list
-#define MAX_NAME_SIZE 30
+// Number of processes allocated at once when the pool is empty
+#define POOL_CHUNK_SIZE 64
 
-proc_t *initProcList() {
-    proc_t *head = safe_malloc(sizeof(head));
-    *head = NULL;
-    return head;
+// Initial number of slots of an index (must be a power of two)
+#define INDEX_INITIAL_CAPACITY 16
+
+// Initial number of 64-bit words of the used ID bitmap
+#define ID_BITMAP_INITIAL_WORDS 1
+
+// Hash table from a key (PID or ID, never 0) to a process, with linear probing
+typedef struct procIndex {
+    int *keys;       // Key of each slot (0 if the slot is empty)
+    proc_t *procs;   // Process of each slot
+    size_t capacity; // Number of slots (a power of two)
+    size_t count;    // Number of used slots
+} procIndex;
+
+// The list and its indexes, the head pointer given to the users is the first field
+// so that a proc_t * can be converted back to its table
+typedef struct procTable {
+    proc_t head;       // Head of the list (must stay the first field)
+    procIndex byPID;   // Processes indexed by PID
+    procIndex byID;    // Processes indexed by ID
+    proc_t mostRecent; // Last modified process, followed by the others through their older field
+    proc_t tail;       // Last process of the list (highest ID)
+    uint64_t *usedIDs; // Bit i is set if ID i + 1 is used
+    size_t idWords;    // Number of words of usedIDs
+    size_t freeHint;   // No word before this one has a free bit
+    int stateCounts[UNDEFINED + 1]; // Number of processes in each state
+} procTable;
+
+static procTable *tableOf(proc_t *head) { return (procTable *)head; }
+
+// Block of processes of the pool
+typedef struct poolChunk {
+    struct poolChunk *next; // Next allocated chunk
+    struct procList procs[POOL_CHUNK_SIZE];
+} poolChunk;
+
+static poolChunk *chunks = NULL;   // Every chunk allocated by the pool
+static proc_t freeProcs = NULL;    // Unused processes, linked by their next field
+static int liveTables = 0;         // Number of lists not deleted yet
+
+// Take a process from the pool
+static proc_t allocProcess() {
+    if (freeProcs == NULL) {
+        DEBUG_PRINT("Process pool empty, allocating a new chunk\n");
+        poolChunk *chunk = safe_malloc(sizeof(poolChunk));
+        chunk->next = chunks;
+        chunks = chunk;
+        for (int i = 0; i < POOL_CHUNK_SIZE; i++) {
+            chunk->procs[i].nameBuffer = NULL;
+            chunk->procs[i].nameBufferSize = 0;
+            chunk->procs[i].memberBuffer = NULL;
+            chunk->procs[i].memberBufferSize = 0;
+            chunk->procs[i].next = freeProcs;
+            freeProcs = &chunk->procs[i];
+        }
+    }
+    proc_t proc = freeProcs;
+    freeProcs = proc->next;
+    return proc;
 }
 
-int addProcess(proc_t *head, int pid, state status, char **commandName) {
-    DEBUG_PRINTF("Adding process %d to the list\n", pid);
-    if (*head == NULL) { // The list is empty
-        DEBUG_PRINT("List initialized\n");
-        *head = createProcess(1, pid, status, commandName);
-        return 1;
+// Give a process back to the pool, its name buffer is kept for the next user
+static void releaseProcess(proc_t proc) {
+    proc->next = freeProcs;
+    freeProcs = proc;
+}
+
+// Free the memory of the pool, every process must have been released
+static void deletePool() {
+    while (chunks != NULL) {
+        poolChunk *next = chunks->next;
+        for (int i = 0; i < POOL_CHUNK_SIZE; i++) {
+            free(chunks->procs[i].nameBuffer);
+            free(chunks->procs[i].memberBuffer);
+        }
+        free(chunks);
+        chunks = next;
     }
-    else {
-        proc_t current = *head;
-        // Reach the end of the list
-        while (current->next != NULL) {
-            current = current->next;
+    freeProcs = NULL;
+}
+
+// Store the command line "arg0 arg1 ... &" in the process, truncated to MAX_NAME_SIZE
+static void setCommandName(proc_t proc, char **commandName) {
+    // Size of the whole command line: each argument followed by a space or " &\0"
+    size_t size = 2;
+    for (char **arg = commandName; *arg != NULL; arg++) {
+        size += strlen(*arg) + 1;
+    }
+    if (size > MAX_NAME_SIZE) {
+        DEBUG_PRINT("Command name too long\n");
+        size = MAX_NAME_SIZE;
+    }
+
+    char *name = proc->inlineName;
+    if (size > INLINE_NAME_SIZE) {
+        if (proc->nameBufferSize < size) {
+            free(proc->nameBuffer);
+            proc->nameBuffer = safe_malloc(size);
+            proc->nameBufferSize = size;
+        }
+        name = proc->nameBuffer;
+    }
+
+    // Copy the arguments while they fit, keeping room for " &"
+    size_t length = 0;
+    for (char **arg = commandName; *arg != NULL; arg++) {
+        size_t argLength = strlen(*arg);
+        size_t needed = (length > 0) + argLength;
+        if (length + needed + 3 > size) {
+            if (length == 0) { // Keep at least the beginning of the command
+                length = size - 3;
+                memcpy(name, *arg, length);
+            }
+            break;
+        }
+        if (length > 0) {
+            name[length++] = ' ';
         }
-        int newID = current->id + 1;
-        current->next = createProcess(newID, pid, status, commandName);
-        return newID;
+        memcpy(name + length, *arg, argLength);
+        length += argLength;
     }
+    memcpy(name + length, " &", 3);
+    proc->commandName = name;
+    proc->nameLength = length + 2;
 }
 
-proc_t createProcess(int id, int pid, state status, char **commandName) {
-    proc_t newProc;
-    DEBUG_PRINT("Allocating new process\n");
-    newProc = safe_malloc(sizeof(struct procList));
-
-    // Copy the command line
-    char *name = safe_malloc(MAX_NAME_SIZE);
-    strcpy(name, *commandName);
-    char **ptr = commandName;
-    for (char *c = *++ptr; c != NULL; c = *++ptr) {
-        if (strlen(name) + strlen(c) + 4 < MAX_NAME_SIZE) {
-            strcat(name, " ");
-            strcat(name, c);
+// Add a PID to the processes of a job, growing its storage if needed
+static void appendMember(proc_t proc, int pid) {
+    if (proc->memberCount == proc->memberCapacity) {
+        int capacity = 2 * proc->memberCapacity;
+        if (proc->memberBufferSize < capacity) {
+            int *buffer = safe_malloc(capacity * sizeof(int));
+            memcpy(buffer, proc->members, proc->memberCount * sizeof(int));
+            free(proc->memberBuffer);
+            proc->memberBuffer = buffer;
+            proc->memberBufferSize = capacity;
         }
         else {
-            DEBUG_PRINT("Command name too long\n");
+            memcpy(proc->memberBuffer, proc->members, proc->memberCount * sizeof(int));
+        }
+        proc->members = proc->memberBuffer;
+        proc->memberCapacity = proc->memberBufferSize;
+    }
+    proc->members[proc->memberCount++] = pid;
+    proc->liveMembers++;
+}
+
+static void initIndex(procIndex *index, size_t capacity) {
+    index->keys = safe_malloc(capacity * sizeof(int));
+    memset(index->keys, 0, capacity * sizeof(int));
+    index->procs = safe_malloc(capacity * sizeof(proc_t));
+    index->capacity = capacity;
+    index->count = 0;
+}
+
+static void deleteIndex(procIndex *index) {
+    free(index->keys);
+    free(index->procs);
+}
+
+// Slot where the search for a key starts (Fibonacci hashing)
+static size_t homeSlot(const procIndex *index, int key) {
+    return ((uint32_t)key * 2654435769u) & (index->capacity - 1);
+}
+
+// Slot containing key, or the empty slot ending its probe sequence
+static size_t findSlot(const procIndex *index, int key) {
+    size_t mask = index->capacity - 1;
+    size_t i = homeSlot(index, key);
+    while (index->keys[i] != 0 && index->keys[i] != key) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+static proc_t indexGet(const procIndex *index, int key) {
+    size_t i = findSlot(index, key);
+    return index->keys[i] != 0 ? index->procs[i] : NULL;
+}
+
+static void indexPut(procIndex *index, int key, proc_t proc) {
+    // Keep the load factor under 1/2 to keep the probe sequences short
+    if (2 * (index->count + 1) > index->capacity) {
+        procIndex old = *index;
+        initIndex(index, 2 * old.capacity);
+        for (size_t i = 0; i < old.capacity; i++) {
+            if (old.keys[i] != 0) {
+                indexPut(index, old.keys[i], old.procs[i]);
+            }
+        }
+        deleteIndex(&old);
+    }
+    size_t i = findSlot(index, key);
+    if (index->keys[i] == 0) {
+        index->count++;
+    }
+    index->keys[i] = key;
+    index->procs[i] = proc;
+}
+
+static void indexRemove(procIndex *index, int key) {
+    size_t mask = index->capacity - 1;
+    size_t i = findSlot(index, key);
+    if (index->keys[i] == 0) {
+        return;
+    }
+    index->count--;
+    // Shift back the following entries of the probe sequence to fill the hole
+    size_t j = i;
+    while (true) {
+        j = (j + 1) & mask;
+        if (index->keys[j] == 0) {
             break;
         }
+        size_t home = homeSlot(index, index->keys[j]);
+        // The entry can move to i if its home slot is not in (i, j] (cyclically)
+        bool stays = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+        if (!stays) {
+            index->keys[i] = index->keys[j];
+            index->procs[i] = index->procs[j];
+            i = j;
+        }
+    }
+    index->keys[i] = 0;
+}
+
+// Remove a process from the modification order
+static void unlinkRecent(procTable *table, proc_t proc) {
+    if (proc->newer != NULL) {
+        proc->newer->older = proc->older;
+    }
+    else {
+        table->mostRecent = proc->older;
+    }
+    if (proc->older != NULL) {
+        proc->older->newer = proc->newer;
+    }
+}
+
+// Make a process the last modified one
+static void touchProcess(procTable *table, proc_t proc) {
+    if (table->mostRecent != proc) {
+        unlinkRecent(table, proc);
+        proc->newer = NULL;
+        proc->older = table->mostRecent;
+        if (proc->older != NULL) {
+            proc->older->newer = proc;
+        }
+        table->mostRecent = proc;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &(proc->time));
+}
+
+// Reserve the lowest free ID
+static int allocateID(procTable *table) {
+    size_t w = table->freeHint;
+    while (w < table->idWords && table->usedIDs[w] == UINT64_MAX) {
+        w++;
+    }
+    if (w == table->idWords) { // Every ID is used, double the bitmap
+        table->usedIDs = realloc(table->usedIDs, 2 * table->idWords * sizeof(uint64_t));
+        if (table->usedIDs == NULL) {
+            fprintf(stderr, "Fatal: failed to grow the ID bitmap.\n");
+            exit(EXIT_FAILURE);
+        }
+        memset(table->usedIDs + table->idWords, 0, table->idWords * sizeof(uint64_t));
+        table->idWords *= 2;
+    }
+    table->freeHint = w;
+    int bit = __builtin_ctzll(~table->usedIDs[w]);
+    table->usedIDs[w] |= (uint64_t)1 << bit;
+    return (int)(w * 64) + bit + 1;
+}
+
+static void freeID(procTable *table, int id) {
+    size_t w = (size_t)(id - 1) / 64;
+    table->usedIDs[w] &= ~((uint64_t)1 << ((id - 1) % 64));
+    if (w < table->freeHint) {
+        table->freeHint = w;
+    }
+}
+
+// Unlink a process from the list and the indexes and give it back to the pool
+static void removeProcess(procTable *table, proc_t proc) {
+    indexRemove(&table->byID, proc->id);
+    // A reaped PID may have been reused by a newer job, which then owns the index entry
+    for (int i = 0; i < proc->memberCount; i++) {
+        if (indexGet(&table->byPID, proc->members[i]) == proc) {
+            indexRemove(&table->byPID, proc->members[i]);
+        }
+    }
+    unlinkRecent(table, proc);
+    freeID(table, proc->id);
+    table->stateCounts[proc->state]--;
+
+    if (proc->prev != NULL) {
+        proc->prev->next = proc->next;
+    }
+    else {
+        table->head = proc->next;
+    }
+    if (proc->next != NULL) {
+        proc->next->prev = proc->prev;
+    }
+    else {
+        table->tail = proc->prev;
+    }
+    DEBUG_PRINTF("Process %d removed\n", proc->id);
+    releaseProcess(proc);
+}
+
+proc_t *initProcList() {
+    procTable *table = safe_malloc(sizeof(procTable));
+    liveTables++;
+    table->head = NULL;
+    table->mostRecent = NULL;
+    table->tail = NULL;
+    table->usedIDs = safe_malloc(ID_BITMAP_INITIAL_WORDS * sizeof(uint64_t));
+    memset(table->usedIDs, 0, ID_BITMAP_INITIAL_WORDS * sizeof(uint64_t));
+    table->idWords = ID_BITMAP_INITIAL_WORDS;
+    table->freeHint = 0;
+    memset(table->stateCounts, 0, sizeof(table->stateCounts));
+    initIndex(&table->byPID, INDEX_INITIAL_CAPACITY);
+    initIndex(&table->byID, INDEX_INITIAL_CAPACITY);
+    return &table->head;
+}
+
+int addProcess(proc_t *head, int pid, state status, char **commandName) {
+    DEBUG_PRINTF("Adding process %d to the list\n", pid);
+    procTable *table = tableOf(head);
+    proc_t new = createProcess(allocateID(table), pid, status, commandName);
+
+    // Every ID below the new one is used: the new process goes after ID - 1
+    proc_t prev = new->id > 1 ? indexGet(&table->byID, new->id - 1) : NULL;
+    new->prev = prev;
+    new->next = prev != NULL ? prev->next : table->head;
+    if (prev != NULL) {
+        prev->next = new;
+    }
+    else {
+        table->head = new;
+    }
+    if (new->next != NULL) {
+        new->next->prev = new;
     }
-    strcat(name, " &");
+    else {
+        table->tail = new;
+    }
+
+    if (pid != 0) {
+        indexPut(&table->byPID, pid, new);
+    }
+    indexPut(&table->byID, new->id, new);
+    table->stateCounts[status]++;
+    // The new process is the last modified one
+    new->older = table->mostRecent;
+    if (new->older != NULL) {
+        new->older->newer = new;
+    }
+    table->mostRecent = new;
+    return new->id;
+}
 
+proc_t createProcess(int id, int pid, state status, char **commandName) {
+    proc_t newProc = allocProcess();
+    setCommandName(newProc, commandName);
     newProc->id = id;
     newProc->pid = pid;
     newProc->state = status;
-    newProc->commandName = name;
-    gettimeofday(&(newProc->time), NULL);
+    clock_gettime(CLOCK_MONOTONIC, &(newProc->time));
     newProc->next = NULL;
+    newProc->prev = NULL;
+    newProc->newer = NULL;
+    newProc->older = NULL;
+    newProc->members = newProc->inlineMembers;
+    newProc->memberCount = 0;
+    newProc->memberCapacity = INLINE_MEMBERS;
+    newProc->liveMembers = 0;
+    if (pid != 0) {
+        appendMember(newProc, pid);
+    }
+    memset(&newProc->usage, 0, sizeof(struct rusage));
+    newProc->exitStatus = 0;
     return newProc;
 }
 
-int lengthProcList(proc_t *head) {
-    proc_t current = *head;
-    int n = 0;
-    while (current != NULL) {
-        n++;
-        current = current->next;
+void addProcessMember(proc_t *head, int id, int pid) {
+    procTable *table = tableOf(head);
+    proc_t proc = indexGet(&table->byID, id);
+    if (proc == NULL) {
+        DEBUG_PRINTF("Process %d not found\n", id);
+        return;
     }
-    return n;
+    DEBUG_PRINTF("Adding process %d to job %d\n", pid, id);
+    if (proc->memberCount == 0) { // First process of a queued job
+        proc->pid = pid;
+    }
+    appendMember(proc, pid);
+    indexPut(&table->byPID, pid, proc);
 }
 
-void removeProcessByID(proc_t *head, int id) {
-    if (*head == NULL) {
-        return; // Don't do anything if the list is empty
+int reapProcessByPID(proc_t *head, int pid, int status) {
+    proc_t proc = indexGet(&tableOf(head)->byPID, pid);
+    if (proc == NULL) {
+        DEBUG_PRINTF("[%d] Process not found in the list\n", pid);
+        return -1;
     }
+    // The PID stays in the index until the job is removed, for the signals sent to the job
+    proc->liveMembers--;
+    if (pid == proc->members[proc->memberCount - 1]) {
+        proc->exitStatus = status;
+    }
+    DEBUG_PRINTF("[%d] Process reaped, %d left in job %d\n", pid, proc->liveMembers, proc->id);
+    return proc->liveMembers;
+}
+
+// Add two durations of a struct rusage
+static void addTimeval(struct timeval *sum, const struct timeval *t) {
+    sum->tv_sec += t->tv_sec;
+    sum->tv_usec += t->tv_usec;
+    if (sum->tv_usec >= 1000000) {
+        sum->tv_sec++;
+        sum->tv_usec -= 1000000;
+    }
+}
 
-    if ((*head)->id == id) {
-        // Remove the first process of the list
-        proc_t next = (*head)->next;
-        free((*head)->commandName);
-        free(*head);
-        *head = next;
-        DEBUG_PRINTF("Process %d removed\n", id);
+void addProcessUsage(proc_t *head, int pid, const struct rusage *usage) {
+    proc_t proc = indexGet(&tableOf(head)->byPID, pid);
+    if (proc == NULL) {
+        DEBUG_PRINTF("[%d] Process not found in the list\n", pid);
         return;
     }
+    addTimeval(&proc->usage.ru_utime, &usage->ru_utime);
+    addTimeval(&proc->usage.ru_stime, &usage->ru_stime);
+    if (usage->ru_maxrss > proc->usage.ru_maxrss) {
+        proc->usage.ru_maxrss = usage->ru_maxrss;
+    }
+    proc->usage.ru_nvcsw += usage->ru_nvcsw;
+    proc->usage.ru_nivcsw += usage->ru_nivcsw;
+    proc->usage.ru_inblock += usage->ru_inblock;
+    proc->usage.ru_oublock += usage->ru_oublock;
+}
+
+void getProcessUsageByPID(proc_t *head, int pid, struct rusage *usage) {
+    proc_t proc = indexGet(&tableOf(head)->byPID, pid);
+    if (proc != NULL) {
+        *usage = proc->usage;
+    }
+}
+
+int getProcessExitStatusByPID(proc_t *head, int pid) {
+    proc_t proc = indexGet(&tableOf(head)->byPID, pid);
+    return proc != NULL ? proc->exitStatus : 0;
+}
 
-    // Remove a process that is not the first in the list
+int lengthProcList(proc_t *head) {
     proc_t current = *head;
-    while (current->next != NULL && current->next->id != id) {
+    int n = 0;
+    while (current != NULL) {
+        n++;
         current = current->next;
     }
-    if (current->next != NULL) {
-        proc_t tmp = current->next;
-        current->next = tmp->next;
-        free(tmp->commandName);
-        free(tmp);
-        DEBUG_PRINTF("Process %d removed\n", id);
+    return n;
+}
+
+void removeProcessByID(proc_t *head, int id) {
+    procTable *table = tableOf(head);
+    proc_t proc = indexGet(&table->byID, id);
+    if (proc == NULL) {
+        DEBUG_PRINTF("Process %d not found\n", id);
         return;
     }
-    DEBUG_PRINTF("Process %d not found\n", id);
+    removeProcess(table, proc);
 }
 
 void removeProcessByPID(proc_t *head, int pid) {
@@ -124,23 +506,24 @@ void printProcess(proc_t proc, int lastID, int previousID) {
         printf("Stopped\t\t      ");
     else if (proc->state == ACTIVE)
         printf("Running\t\t      ");
+    else if (proc->state == DONE && WIFSIGNALED(proc->exitStatus))
+        printf("%s\t\t      ", strsignal(WTERMSIG(proc->exitStatus)));
     else if (proc->state == DONE)
         printf("Done\t\t      ");
+    else if (proc->state == QUEUED)
+        printf("Queued\t\t      ");
     // Print the command executed by the process
     printf("%s\n", proc->commandName);
 }
 
 void printProcessByID(proc_t *head, int id) {
+    proc_t proc = indexGet(&tableOf(head)->byID, id);
+    if (proc == NULL) {
+        return;
+    }
     int lastID, previousID;
     getLastTwoProcesses(head, &lastID, &previousID);
-    proc_t current = *head;
-    while (current != NULL) {
-        // Print the information about the process
-        if (current->id == id) {
-            printProcess(current, lastID, previousID);
-        }
-        current = current->next;
-    }
+    printProcess(proc, lastID, previousID);
 }
 
 void printProcessByPID(proc_t *head, int pid) { printProcessByID(head, getID(head, pid)); }
@@ -165,53 +548,64 @@ void printProcList(proc_t *head) {
     }
 }
 
-void getLastTwoProcesses(proc_t *head, int *lastID, int *previousID) {
-    // Initialize previous and last to minimum time
-    *lastID = 0;
-    *previousID = 0;
-    struct timeval lastTime;
-    timerclear(&lastTime);
-    struct timeval previousTime;
-    timerclear(&previousTime);
+void printProcListUsage(proc_t *head) {
+    if (*head == NULL) { // Empty list
+        printf("\n");
+        return;
+    }
+    int lastID, previousID;
+    getLastTwoProcesses(head, &lastID, &previousID);
+    for (proc_t current = *head; current != NULL; current = current->next) {
+        printProcess(current, lastID, previousID);
+        const struct rusage *u = &current->usage;
+        printf("      user %ld.%06lds  sys %ld.%06lds  max RSS %ld KiB  switches %ld/%ld\n",
+               (long)u->ru_utime.tv_sec, (long)u->ru_utime.tv_usec, (long)u->ru_stime.tv_sec,
+               (long)u->ru_stime.tv_usec, u->ru_maxrss, u->ru_nvcsw, u->ru_nivcsw);
+    }
+}
 
-    proc_t current = *head;
+void getLastTwoProcesses(proc_t *head, int *lastID, int *previousID) {
+    proc_t last = tableOf(head)->mostRecent;
+    *lastID = last != NULL ? last->id : 0;
+    *previousID = (last != NULL && last->older != NULL) ? last->older->id : 0;
+}
 
-    while (current != NULL) {
-        // current time > last time
-        if (timercmp(&(current->time), &lastTime, >)) {
-            // Update previous and last
-            previousTime = lastTime;
-            *previousID = *lastID;
-            lastTime = current->time;
-            *lastID = current->id;
-        }
-        // current time > previous time
-        else if (current->id != *lastID && timercmp(&(current->time), &previousTime, >)) {
-            // Update previous
-            previousTime = current->time;
-            *previousID = current->id;
-        }
-        current = current->next;
-    }
+// Change the status of a process and make it the last modified one
+static void setStatus(procTable *table, proc_t proc, state status) {
+    table->stateCounts[proc->state]--;
+    table->stateCounts[status]++;
+    proc->state = status;
+    touchProcess(table, proc);
+    DEBUG_PRINTF("[%d] Status changed to %d\n", proc->pid, proc->state);
 }
 
 void setProcessStatusByPID(proc_t *head, int pid, state status) {
-    proc_t current = *head;
-    while (current != NULL) {
-        if (current->pid == pid) {
-            current->state = status;
-            gettimeofday(&(current->time), NULL);
-            DEBUG_PRINTF("[%d] Status changed to %d\n", pid, current->state);
-            return;
-        }
-        current = current->next;
+    procTable *table = tableOf(head);
+    proc_t proc = indexGet(&table->byPID, pid);
+    if (proc == NULL) {
+        DEBUG_PRINTF("[%d] Process not found in the list\n", pid);
+        return;
     }
-    DEBUG_PRINTF("[%d] Process not found in the list\n", pid);
+    setStatus(table, proc, status);
 }
 
 void setProcessStatusByID(proc_t *head, int id, state status) {
-    int pid = getPID(head, id);
-    setProcessStatusByPID(head, pid, status);
+    procTable *table = tableOf(head);
+    proc_t proc = indexGet(&table->byID, id);
+    if (proc == NULL) {
+        DEBUG_PRINTF("Process %d not found\n", id);
+        return;
+    }
+    setStatus(table, proc, status);
+}
+
+state getProcessStatusByID(proc_t *head, int id) {
+    proc_t proc = indexGet(&tableOf(head)->byID, id);
+    return proc != NULL ? proc->state : UNDEFINED;
+}
+
+int countProcesses(proc_t *head, state status) {
+    return tableOf(head)->stateCounts[status];
 }
 
 void updateProcList(proc_t *head) {
@@ -222,49 +616,35 @@ void updateProcList(proc_t *head) {
     int lastID, previousID;
     getLastTwoProcesses(head, &lastID, &previousID);
 
+    // Print and unlink the completed processes in a single pass
     while (current != NULL) {
         next = current->next;
         if (current->state == DONE) {
             printProcess(current, lastID, previousID);
-            removeProcessByID(head, current->id);
+            removeProcess(tableOf(head), current);
         }
         current = next;
     }
 }
 
 state getProcessStatusByPID(proc_t *head, int pid) {
-    proc_t current = *head;
-    while (current != NULL) {
-        if (current->pid == pid) {
-            DEBUG_PRINTF("[%d] Status found = %d\n", pid, current->state);
-            return current->state;
-        }
-        current = current->next;
+    proc_t proc = indexGet(&tableOf(head)->byPID, pid);
+    if (proc == NULL) {
+        DEBUG_PRINTF("[%d] Process not found in the list\n", pid);
+        return UNDEFINED;
     }
-    DEBUG_PRINTF("[%d] Process not found in the list\n", pid);
-    return UNDEFINED;
+    DEBUG_PRINTF("[%d] Status found = %d\n", pid, proc->state);
+    return proc->state;
 }
 
 int getID(proc_t *head, int pid) {
-    proc_t current = *head;
-    while (current != NULL) {
-        if (current->pid == pid) {
-            return current->id;
-        }
-        current = current->next;
-    }
-    return 0;
+    proc_t proc = indexGet(&tableOf(head)->byPID, pid);
+    return proc != NULL ? proc->id : 0;
 }
 
 int getPID(proc_t *head, int id) {
-    proc_t current = *head;
-    while (current != NULL) {
-        if (current->id == id) {
-            return current->pid;
-        }
-        current = current->next;
-    }
-    return 0;
+    proc_t proc = indexGet(&tableOf(head)->byID, id);
+    return proc != NULL ? proc->pid : 0;
 }
 
 void deleteProcList(proc_t *head) {
@@ -273,8 +653,14 @@ void deleteProcList(proc_t *head) {
     while (current != NULL) {
         tmp = current;
         current = current->next;
-        free(tmp->commandName);
-        free(tmp);
+        releaseProcess(tmp);
+    }
+    procTable *table = tableOf(head);
+    deleteIndex(&table->byPID);
+    deleteIndex(&table->byID);
+    free(table->usedIDs);
+    free(table);
+    if (--liveTables == 0) {
+        deletePool();
     }
-    free(head);
 }
\ No newline at end of file
@@ -5,10 +5,23 @@
 #ifndef __PROCLIST_H
 #define __PROCLIST_H
 
-#include <sys/time.h>
+#include <stddef.h>
+#include <sys/resource.h>
+#include <time.h>
+
+// Maximum size of a command line to keep in the process list (longer ones are truncated)
+#ifndef MAX_NAME_SIZE
+#define MAX_NAME_SIZE 4096
+#endif
+
+// Size of the command line stored in the process itself, longer ones use nameBuffer
+#define INLINE_NAME_SIZE 64
+
+// Number of PIDs of a job stored in the process itself, larger pipelines use memberBuffer
+#define INLINE_MEMBERS 4
 
 // Define the state of a process
-typedef enum state { SUSPENDED, ACTIVE, DONE, UNDEFINED } state;
+typedef enum state { SUSPENDED, ACTIVE, DONE, QUEUED, UNDEFINED } state;
 
 // Struct to define a process
 typedef struct procList {
@@ -16,8 +29,24 @@ typedef struct procList {
     int pid;               // Process ID
     state state;           // Current state of the process
     char *commandName;     // Name of the command executed by this process
-    struct timeval time;   // Time at which the process state was last modified
-    struct procList *next; // Next process in the list
+    size_t nameLength;     // Length of commandName
+    struct timespec time;  // Time at which the process state was last modified (monotonic)
+    struct procList *next; // Next process in the list (ordered by ID)
+    struct procList *prev; // Previous process in the list
+    struct procList *newer; // Process modified just after this one
+    struct procList *older; // Process modified just before this one
+    char *nameBuffer;      // Storage of long command names, kept when the process is reused
+    size_t nameBufferSize; // Size of nameBuffer
+    char inlineName[INLINE_NAME_SIZE]; // Storage of short command names
+    int *members;          // PIDs of the processes of the job (pipeline stages), pid first
+    int memberCount;       // Number of processes of the job
+    int memberCapacity;    // Size of members
+    int liveMembers;       // Number of processes of the job not reaped yet
+    int *memberBuffer;     // Storage of large jobs, kept when the process is reused
+    int memberBufferSize;  // Size of memberBuffer
+    int inlineMembers[INLINE_MEMBERS]; // Storage of small jobs
+    struct rusage usage;   // Resources used by the reaped processes of the job
+    int exitStatus;        // Wait status of the last process of the job, once reaped
 } * proc_t;
 
 /*
@@ -25,9 +54,8 @@ typedef struct procList {
  * --------------------
  *   Initialize the process list
  *
- *   id: the ID of the process in the minishell
- *   pid: the process ID
- *   commandName: the name of the command executed by this process
+ *   Notes: the processes are also indexed by PID and by ID, so that lookups don't
+ *   walk the list. The list must only be modified through the functions of this file.
  *
  *   Return: the head of the created process list
  */
@@ -38,6 +66,9 @@ proc_t *initProcList();
  * --------------------
  *   Create a new process list
  *
+ *   Notes: the processes are taken from a pool shared by all the lists, memory is only
+ *   allocated when the pool is empty and released when the last list is deleted
+ *
  *   id: the ID of the process in the minishell
  *   pid: the process ID
  *   status: the status of the process
@@ -50,10 +81,10 @@ proc_t createProcess(int id, int pid, state status, char **commandName);
 /*
  * Function: addProcess
  * --------------------
- *   Add a process to the list
+ *   Add a process to the list, with the lowest ID not used by another process
  *
  *   head: a pointer to the the head of the list
- *   pid: the process ID
+ *   pid: the process ID, 0 for a job whose processes don't exist yet (QUEUED)
  *   status: the status of the process
  *   commandName: the name of the command executed by this process
  *
@@ -61,6 +92,69 @@ proc_t createProcess(int id, int pid, state status, char **commandName);
  */
 int addProcess(proc_t *head, int pid, state status, char **commandName);
 
+/*
+ * Function: addProcessMember
+ * --------------------------
+ *   Add a process to a job, the job is found by the PID of each of its processes
+ *   and it ends once all of them are reaped. The first process of a job added
+ *   without PID gives it its PID.
+ *
+ *   head: the head of the list
+ *   id: the ID of the job
+ *   pid: the PID of the new process
+ */
+void addProcessMember(proc_t *head, int id, int pid);
+
+/*
+ * Function: reapProcessByPID
+ * --------------------------
+ *   Record the end of a process of a job, the status of the job is the one of its
+ *   last process (like the status of a pipeline)
+ *
+ *   head: the head of the list
+ *   pid: the PID of the process
+ *   status: the wait status of the process
+ *
+ *   Return: the number of processes of the job not reaped yet, -1 if pid isn't in the list
+ */
+int reapProcessByPID(proc_t *head, int pid, int status);
+
+/*
+ * Function: getProcessExitStatusByPID
+ * -----------------------------------
+ *   Get the wait status of a job
+ *
+ *   head: the head of the list
+ *   pid: the PID of a process of the job
+ *
+ *   Return: the wait status of the last process of the job, 0 if it wasn't reaped
+ *   or if pid isn't in the list
+ */
+int getProcessExitStatusByPID(proc_t *head, int pid);
+
+/*
+ * Function: addProcessUsage
+ * -------------------------
+ *   Add the resources used by a reaped process to its job: the times, context switches
+ *   and block operations are summed, the maximum resident set size is the largest one
+ *
+ *   head: the head of the list
+ *   pid: the PID of the process
+ *   usage: the resources used by the process, as given by wait4
+ */
+void addProcessUsage(proc_t *head, int pid, const struct rusage *usage);
+
+/*
+ * Function: getProcessUsageByPID
+ * ------------------------------
+ *   Get the resources used by the reaped processes of a job
+ *
+ *   head: the head of the list
+ *   pid: the PID of a process of the job
+ *   usage: set to the resources used by the job, unchanged if pid isn't in the list
+ */
+void getProcessUsageByPID(proc_t *head, int pid, struct rusage *usage);
+
 /*
  * Function: lengthProcList
  * ------------------------
@@ -134,11 +228,29 @@ void printProcessByPID(proc_t *head, int pid);
  */
 void printProcList(proc_t *head);
 
+/*
+ * Function: printProcListUsage
+ * ----------------------------
+ *   Print the process list, each process followed by the resources used by its
+ *   reaped processes
+ *
+ *   Example:
+ *     [1]+  Done                    make &
+ *           user 1.204311s  sys 0.310020s  max RSS 45312 KiB  switches 120/35
+ *
+ *   Notes: the context switches are given as voluntary/involuntary
+ *
+ *   head: a pointer to the the head of the list
+ */
+void printProcListUsage(proc_t *head);
+
 /*
  * Function: getLastTwoProcesses
  * -----------------------------
  *   Get the last two processes from the process list
  *
+ *   Notes: the processes are kept ordered by modification time, this takes constant time
+ *
  *   head: a pointer to the the head of the list
  *   lastID: (out) the ID of the last modified process found (0 if not found)
  *   previousID: (out) the ID of the second-to-last modified process found (0 if not found)
@@ -167,6 +279,30 @@ void setProcessStatusByPID(proc_t *head, int pid, state status);
  */
 void setProcessStatusByID(proc_t *head, int id, state status);
 
+/*
+ * Function: getProcessStatusByID
+ * ------------------------------
+ *   Get the status of a process with its ID, which also finds the queued jobs
+ *
+ *   head: a pointer to the the head of the list
+ *   id: the ID of the process
+ *
+ *   Return: the state of the process (UNDEFINED if not found)
+ */
+state getProcessStatusByID(proc_t *head, int id);
+
+/*
+ * Function: countProcesses
+ * ------------------------
+ *   Count the processes in a state, in constant time
+ *
+ *   head: a pointer to the the head of the list
+ *   status: the state
+ *
+ *   Return: the number of processes in this state
+ */
+int countProcesses(proc_t *head, state status);
+
 /*
  * Function: getProcessStatusByPID
  * -------------------------------
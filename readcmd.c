@@ -9,10 +9,12 @@
 #include "readcmd.h"
 #include <errno.h>
 #include <limits.h>
+#include <stdint.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 static void memory_error(void) {
     errno = ENOMEM;
@@ -34,42 +36,231 @@ static void *xrealloc(void *ptr, size_t size) {
     return p;
 }
 
-/* Read a line from standard input and put it in a char[] */
-static char *readline(void) {
-    size_t buf_len = 16;
-    char *buf = xmalloc(buf_len * sizeof(char));
-    if (fgets(buf, buf_len, stdin) == NULL) {
-        free(buf);
-        return NULL;
+/* Input buffer, kept from one line to the next: standard input is read by large
+ * chunks and the bytes after the returned line are kept for the next calls. */
+#define READ_CHUNK_SIZE 65536
+static char *input_buf = 0;    /* Bytes read from standard input */
+static size_t input_size = 0;  /* Capacity of input_buf */
+static size_t input_start = 0; /* First byte not returned yet */
+static size_t input_end = 0;   /* End of the bytes read */
+static int input_eof = 0;      /* Has the end of standard input been reached ? */
+static int input_owned = 1;    /* Was input_buf allocated here (or given by readcmd_from) ? */
+
+/* Read a line from standard input, without its newline, and store its length in len.
+ * The line points into the input buffer and is valid until the next call. */
+static char *readline(size_t *len) {
+    size_t searched = input_start; /* Bytes before this one contain no newline */
+    for (;;) {
+        char *nl = 0;
+        if (searched < input_end)
+            nl = memchr(input_buf + searched, '\n', input_end - searched);
+        if (nl) {
+            char *line = input_buf + input_start;
+            *nl = 0;
+            *len = nl - line;
+            input_start = nl - input_buf + 1;
+            return line;
+        }
+        searched = input_end;
+
+        if (input_eof) {
+            /* Return the last line even if it has no newline */
+            if (input_start == input_end)
+                return NULL;
+            char *line = input_buf + input_start;
+            input_buf[input_end] = 0; /* There is always room for it, see below */
+            *len = input_end - input_start;
+            input_start = input_end;
+            return line;
+        }
+
+        /* Move the beginning of the line to the start of the buffer, and make room
+         * for a whole chunk plus a terminating null byte */
+        if (input_start > 0) {
+            memmove(input_buf, input_buf + input_start, input_end - input_start);
+            input_end -= input_start;
+            searched -= input_start;
+            input_start = 0;
+        }
+        if (input_size - input_end < READ_CHUNK_SIZE + 1) {
+            if (input_size >= (SIZE_MAX / 4))
+                memory_error();
+            input_size = input_size ? 2 * input_size : 2 * READ_CHUNK_SIZE;
+            input_buf = xrealloc(input_buf, input_size);
+        }
+
+        ssize_t n = read(STDIN_FILENO, input_buf + input_end, input_size - input_end - 1);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("read");
+            n = 0;
+        }
+        if (n == 0)
+            input_eof = 1;
+        input_end += n;
     }
+}
+
+void readcmd_from(char *buf, size_t len) {
+    if (input_owned)
+        free(input_buf);
+    input_buf = buf;
+    input_size = len + 1;
+    input_start = 0;
+    input_end = len;
+    input_eof = 1; /* Nothing more to read once the buffer is consumed */
+    input_owned = 0;
+}
+
+int readcmd_ready(void) {
+    return input_eof || (input_start < input_end &&
+                         memchr(input_buf + input_start, '\n', input_end - input_start) != 0);
+}
+
+/* Memory of the last command line: the words point into the line itself (in the
+ * input buffer), and the word and command arrays are carved out of a single buffer
+ * which is kept from one command to the next (reset, not freed), so a command costs
+ * no allocation once the buffer is large enough. */
+static char **arena = 0;       /* Words of the line, followed by the commands and seq */
+static size_t arena_size = 0;  /* Capacity of arena, in pointers */
+
+/* Make room for at least n pointers in the arena */
+static void arena_reserve(size_t n) {
+    if (n <= arena_size)
+        return;
+    if (arena_size == 0)
+        arena_size = 64;
+    while (arena_size < n)
+        arena_size *= 2;
+    arena = xrealloc(arena, arena_size * sizeof(char *));
+}
+
+static void arena_free(void) {
+    free(arena);
+    arena = 0;
+    arena_size = 0;
+    if (input_owned)
+        free(input_buf);
+    input_buf = 0;
+    input_size = input_start = input_end = 0;
+}
 
-    do {
-        size_t l = strlen(buf);
-        if ((l > 0) && (buf[l - 1] == '\n')) {
-            l--;
-            buf[l] = 0;
-            return buf;
+/* Search of the end of a word: the first byte among the separators of the grammar
+ * (0, ' ', '\t', '<', '>', '|', '&') in [cur, end), or end if there is none.
+ * The vectorized versions compare 16 or 32 bytes at once, the best one supported by
+ * the processor is chosen on the first call (MINISHELL_SCANNER=scalar|sse2|avx2
+ * forces one, to compare them). */
+typedef const char *(*scanner_t)(const char *cur, const char *end);
+
+static const char *scan_word_scalar(const char *cur, const char *end) {
+    for (; cur < end; cur++) {
+        switch (*cur) {
+        case 0:
+        case ' ':
+        case '\t':
+        case '<':
+        case '>':
+        case '|':
+        case '&':
+            return cur;
+        default:;
         }
-        if (buf_len >= (INT_MAX / 2))
-            memory_error();
-        buf_len *= 2;
-        buf = xrealloc(buf, buf_len * sizeof(char));
-        if (fgets(buf + l, buf_len - l, stdin) == NULL)
-
-            return buf;
-    } while (1);
+    }
+    return end;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+/* Bit i is set if cur[i] is a separator, for 16 bytes */
+__attribute__((target("sse2"))) static inline unsigned int separators16(const char *cur) {
+    __m128i b = _mm_loadu_si128((const __m128i *)cur);
+    __m128i m = _mm_or_si128(
+        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(b, _mm_setzero_si128()),
+                                  _mm_cmpeq_epi8(b, _mm_set1_epi8(' '))),
+                     _mm_or_si128(_mm_cmpeq_epi8(b, _mm_set1_epi8('\t')),
+                                  _mm_cmpeq_epi8(b, _mm_set1_epi8('<')))),
+        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(b, _mm_set1_epi8('>')),
+                                  _mm_cmpeq_epi8(b, _mm_set1_epi8('|'))),
+                     _mm_cmpeq_epi8(b, _mm_set1_epi8('&'))));
+    return _mm_movemask_epi8(m);
+}
+
+/* Bit i is set if cur[i] is a separator, for 32 bytes */
+__attribute__((target("avx2"))) static inline unsigned int separators32(const char *cur) {
+    __m256i b = _mm256_loadu_si256((const __m256i *)cur);
+    __m256i m = _mm256_or_si256(
+        _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(b, _mm256_setzero_si256()),
+                                        _mm256_cmpeq_epi8(b, _mm256_set1_epi8(' '))),
+                        _mm256_or_si256(_mm256_cmpeq_epi8(b, _mm256_set1_epi8('\t')),
+                                        _mm256_cmpeq_epi8(b, _mm256_set1_epi8('<')))),
+        _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(b, _mm256_set1_epi8('>')),
+                                        _mm256_cmpeq_epi8(b, _mm256_set1_epi8('|'))),
+                        _mm256_cmpeq_epi8(b, _mm256_set1_epi8('&'))));
+    return _mm256_movemask_epi8(m);
+}
+
+__attribute__((target("sse2"))) static const char *scan_word_sse2(const char *cur,
+                                                                   const char *end) {
+    for (; end - cur >= 16; cur += 16) {
+        unsigned int mask = separators16(cur);
+        if (mask)
+            return cur + __builtin_ctz(mask);
+    }
+    return scan_word_scalar(cur, end);
+}
+
+__attribute__((target("avx2"))) static const char *scan_word_avx2(const char *cur,
+                                                                   const char *end) {
+    /* Most words are short: look at the first 16 bytes before switching to 32 */
+    if (end - cur >= 16) {
+        unsigned int mask = separators16(cur);
+        if (mask)
+            return cur + __builtin_ctz(mask);
+        cur += 16;
+    }
+    for (; end - cur >= 32; cur += 32) {
+        unsigned int mask = separators32(cur);
+        if (mask)
+            return cur + __builtin_ctz(mask);
+    }
+    return scan_word_sse2(cur, end);
 }
+#endif
+
+static const char *scan_word_resolve(const char *cur, const char *end);
+static scanner_t scan_word = scan_word_resolve;
 
-/* Split the string in words, according to the simple shell grammar. */
-static char **split_in_words(char *line) {
+/* Choose the scanner on the first call */
+static const char *scan_word_resolve(const char *cur, const char *end) {
+    const char *forced = getenv("MINISHELL_SCANNER");
+    scan_word = scan_word_scalar;
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (forced ? !strcmp(forced, "avx2") && __builtin_cpu_supports("avx2")
+               : __builtin_cpu_supports("avx2"))
+        scan_word = scan_word_avx2;
+    else if (forced ? !strcmp(forced, "sse2") && __builtin_cpu_supports("sse2")
+                    : __builtin_cpu_supports("sse2"))
+        scan_word = scan_word_sse2;
+#else
+    (void)forced;
+#endif
+    return scan_word(cur, end);
+}
+
+/* Split the string of length len in words, according to the simple shell grammar.
+ * The words are terminated in place in the line and stored at the beginning of the
+ * arena, followed by a null pointer. Return the number of words. */
+static size_t split_in_words(char *line, size_t len) {
     char *cur = line;
-    char **tab = 0;
+    char *end = line + len;
     size_t l = 0;
     char c;
 
     while ((c = *cur) != 0) {
         char *w = 0;
-        char *start;
         switch (c) {
         case ' ':
         case '\t':
@@ -94,89 +285,111 @@ static char **split_in_words(char *line) {
             break;
         default:
             /* Another word */
-            start = cur;
-            while (c) {
-                c = *++cur;
-                switch (c) {
-                case 0:
-                case ' ':
-                case '\t':
-                case '<':
-                case '>':
-                case '|':
-                case '&':
-                    c = 0;
-                    break;
-                default:;
+            w = cur;
+            cur = (char *)scan_word(cur + 1, end);
+            /* Terminate the word in place. A following separator is handled now, since
+             * it is overwritten, an operator is stored right after the word. */
+            c = *cur;
+            if (c != 0) {
+                *cur++ = 0;
+                if (c != ' ' && c != '\t') {
+                    arena_reserve(l + 2);
+                    arena[l++] = w;
+                    w = (c == '<') ? "<" : (c == '>') ? ">" : (c == '|') ? "|" : "&";
                 }
             }
-            w = xmalloc((cur - start + 1) * sizeof(char));
-            strncpy(w, start, cur - start);
-            w[cur - start] = 0;
         }
         if (w) {
-            tab = xrealloc(tab, (l + 1) * sizeof(char *));
-            tab[l++] = w;
+            arena_reserve(l + 2);
+            arena[l++] = w;
         }
     }
-    tab = xrealloc(tab, (l + 1) * sizeof(char *));
-    tab[l++] = 0;
-    return tab;
+    arena_reserve(l + 1);
+    arena[l] = 0;
+    return l;
 }
 
-static void freeseq(char ***seq) {
-    int i, j;
-
-    for (i = 0; seq[i] != 0; i++) {
-        char **cmd = seq[i];
+/* Free the fields of the structure but not the structure itself.
+ * Every field points into the arena, which is reused by the next command. */
+void freecmd(struct cmdline *s) {
+    s->in = 0;
+    s->out = 0;
+    s->backgrounded = 0;
+    s->seq = 0;
+}
 
-        for (j = 0; cmd[j] != 0; j++)
-            free(cmd[j]);
-        free(cmd);
-    }
-    free(seq);
+/* Copy a string to the bytes of a duplicated command, and move them past it */
+static char *dup_string(char **bytes, const char *str) {
+    size_t n = strlen(str) + 1;
+    char *copy = memcpy(*bytes, str, n);
+    *bytes += n;
+    return copy;
 }
 
-/* Free the fields of the structure but not the structure itself */
-void freecmd(struct cmdline *s) {
-    if (s->in)
-        free(s->in);
-    if (s->out)
-        free(s->out);
-    //	if (s->backgrounded) free(s->backgrounded);
-    if (s->seq)
-        freeseq(s->seq);
+struct cmdline *dupcmd(const struct cmdline *s) {
+    size_t ncmds = 0, nwords = 0, nbytes = 0;
+    const char *fields[] = {s->in, s->out, s->backgrounded};
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++)
+        if (fields[i])
+            nbytes += strlen(fields[i]) + 1;
+    for (; s->seq && s->seq[ncmds]; ncmds++)
+        for (char **w = s->seq[ncmds]; *w; w++, nwords++)
+            nbytes += strlen(*w) + 1;
+
+    /* The structure, seq, the words of each command and their null pointer, the bytes */
+    struct cmdline *d = xmalloc(sizeof(struct cmdline) +
+                                (2 * ncmds + 1 + nwords) * sizeof(char *) + nbytes);
+    char ***seq = (char ***)(d + 1);
+    char **words = (char **)(seq + ncmds + 1);
+    char *bytes = (char *)(words + ncmds + nwords);
+    d->err = s->err; /* A string literal */
+    d->in = s->in ? dup_string(&bytes, s->in) : 0;
+    d->out = s->out ? dup_string(&bytes, s->out) : 0;
+    d->backgrounded = s->backgrounded ? dup_string(&bytes, s->backgrounded) : 0;
+    d->seq = s->seq ? seq : 0;
+    for (size_t i = 0; i < ncmds; i++) {
+        seq[i] = words;
+        for (char **w = s->seq[i]; *w; w++)
+            *words++ = dup_string(&bytes, *w);
+        *words++ = 0;
+    }
+    seq[ncmds] = 0;
+    return d;
 }
 
 struct cmdline *readcmd(void) {
     static struct cmdline *static_cmdline = 0;
     struct cmdline *s = static_cmdline;
     char *line;
+    size_t len;
     char **words;
-    int i;
+    size_t nwords, i;
     char *w;
     char **cmd;
     char ***seq;
     size_t cmd_len, seq_len;
 
-    line = readline();
+    line = readline(&len);
     if (line == NULL) {
         if (s) {
             freecmd(s);
             free(s);
         }
+        arena_free();
         return static_cmdline = 0;
     }
 
-    cmd = xmalloc(sizeof(char *));
-    cmd[0] = 0;
+    nwords = split_in_words(line, len);
+    /* Room for the words, the commands (each word once, plus a null pointer per
+     * command) and seq (a pointer per command, plus a null pointer) */
+    arena_reserve(3 * nwords + 3);
+    words = arena;
+    cmd = arena + nwords + 1; /* Words of the current command */
     cmd_len = 0;
-    seq = xmalloc(sizeof(char **));
-    seq[0] = 0;
+    seq = (char ***)(arena + 2 * nwords + 2);
     seq_len = 0;
+    seq[0] = 0;
 
-    words = split_in_words(line);
-    free(line);
     if (!s)
         static_cmdline = s = xmalloc(sizeof(struct cmdline));
     else
@@ -227,65 +440,32 @@ struct cmdline *readcmd(void) {
                 s->err = "misplaced pipe";
                 goto error;
             }
-
-            seq = xrealloc(seq, (seq_len + 2) * sizeof(char **));
+            /* The command ends here, the next one starts after its null pointer */
+            cmd[cmd_len] = 0;
             seq[seq_len++] = cmd;
             seq[seq_len] = 0;
-
-            cmd = xmalloc(sizeof(char *));
-            cmd[0] = 0;
+            cmd += cmd_len + 1;
             cmd_len = 0;
             break;
         default:
-            cmd = xrealloc(cmd, (cmd_len + 2) * sizeof(char *));
             cmd[cmd_len++] = w;
-            cmd[cmd_len] = 0;
         }
     }
 
     if (cmd_len != 0) {
-        seq = xrealloc(seq, (seq_len + 2) * sizeof(char **));
+        cmd[cmd_len] = 0;
         seq[seq_len++] = cmd;
         seq[seq_len] = 0;
     }
     else if (seq_len != 0) {
         s->err = "misplaced pipe";
-        i--;
         goto error;
     }
-    else
-        free(cmd);
-    free(words);
     s->seq = seq;
     return s;
 error:
-    while ((w = words[i++]) != 0) {
-        switch (w[0]) {
-        case '<':
-        case '>':
-        case '|':
-        case '&':
-            break;
-        default:
-            free(w);
-        }
-    }
-    free(words);
-    freeseq(seq);
-    for (i = 0; cmd[i] != 0; i++)
-        free(cmd[i]);
-    free(cmd);
-    if (s->in) {
-        free(s->in);
-        s->in = 0;
-    }
-    if (s->out) {
-        free(s->out);
-        s->out = 0;
-    }
-    if (s->backgrounded) {
-        //		free(s->backgrounded);
-        s->out = 0;
-    }
+    s->in = 0;
+    s->out = 0;
+    s->backgrounded = 0;
     return s;
 }
@@ -1,6 +1,8 @@
 #ifndef __READCMD_H
 #define __READCMD_H
 
+#include <stddef.h>
+
 /* Introduction
 ------------
 Le code fourni a pour but de vous décharger du travail d'analyse d'une ligne de commande,
@@ -51,6 +53,21 @@ struct cmdline *readcmd(void);
 
 void freecmd(struct cmdline *s);
 
+/* The result of readcmd() points into buffers reused by the next call: copy it
+ * into a single allocation, freed with free(), to keep it longer. */
+struct cmdline *dupcmd(const struct cmdline *s);
+
+/* Standard input is read by large chunks: the lines after the one returned by
+ * readcmd() may already be buffered, even if standard input looks idle.
+ * Return non zero if readcmd() can return without reading standard input
+ * (a whole line is buffered or the end of the input was reached). */
+int readcmd_ready(void);
+
+/* Read the next command lines from a buffer instead of standard input (e.g. a
+ * memory-mapped script). The lines are terminated in place, so the buffer must be
+ * writable, including buf[len]. It is not freed by readcmd(). */
+void readcmd_from(char *buf, size_t len);
+
 /* Structure retournée par readcmd() */
 struct cmdline {
     char *err; /* Si non null : message d'erreur à afficher.
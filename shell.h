@@ -0,0 +1,77 @@
+/*
+ * Services of the shell used by the built-in commands
+ */
+
+#ifndef __SHELL_H
+#define __SHELL_H
+
+#include <stdbool.h>
+
+// CTRL+C received while no job was in foreground (a built-in command was running) ?
+extern bool interruptReceived;
+
+// Is this process a built-in command forked by the shell ?
+extern bool forkedBuiltin;
+
+/*
+ * Function: waitForeground
+ * ------------------------
+ *   Make a job the foreground job and handle events until it ends or is stopped
+ *
+ *   pgid: the process group of the job
+ *   resume: send SIGCONT to the job once it owns the terminal ?
+ */
+void waitForeground(int pgid, bool resume);
+
+/*
+ * Function: handleEvents
+ * ----------------------
+ *   Wait for the next events and handle them, the jobs are updated as in waitForeground
+ */
+void handleEvents();
+
+/*
+ * Function: execExternalCommand
+ * -----------------------------
+ *   Execute an external command in a subprocess
+ *
+ *   in: the input descriptor
+ *   out: the output descriptor
+ *   argv: the command and its arguments
+ *   pgid: the process group of the job, 0 to start a new group
+ *
+ *   Return: the PID of the subprocess, -1 if it couldn't be created
+ */
+int execExternalCommand(int in, int out, char **argv, int pgid);
+
+/*
+ * Function: startQueuedJob
+ * ------------------------
+ *   Start a queued job now, whatever the number of running background jobs
+ *
+ *   id: the ID of the job
+ *
+ *   Return: the process group of the job, 0 if it isn't queued or couldn't be started
+ */
+int startQueuedJob(int id);
+
+/*
+ * Function: setMaxJobs
+ * --------------------
+ *   Set the maximum number of background jobs running at the same time, the next
+ *   ones are queued (QUEUED) and started in order as the running ones end or stop
+ *
+ *   max: the maximum number of jobs, 0 for no limit
+ *
+ *   Return: 0 on success, -1 if max is invalid
+ */
+int setMaxJobs(int max);
+
+/*
+ * Function: getMaxJobs
+ * --------------------
+ *   Return: the maximum number of running background jobs, 0 for no limit
+ */
+int getMaxJobs();
+
+#endif
@@ -0,0 +1,87 @@
+#include <errno.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "spawn.h"
+
+extern char **environ;
+
+#if USE_POSIX_SPAWN
+
+// posix_spawn uses a vfork-like clone: the cost doesn't depend on the size of the shell memory
+int spawnCommand(int in, int out, const char *path, char **argv, const sigset_t *mask, int pgid) {
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    pid_t pid;
+
+    posix_spawn_file_actions_init(&actions);
+    // Handle input redirection
+    if (in != STDIN_FILENO) {
+        DEBUG_PRINTF("Input read from %d\n", in);
+        posix_spawn_file_actions_adddup2(&actions, in, STDIN_FILENO);
+        posix_spawn_file_actions_addclose(&actions, in);
+    }
+    // Handle output redirection
+    if (out != STDOUT_FILENO) {
+        DEBUG_PRINTF("Output redirected to %d\n", out);
+        posix_spawn_file_actions_adddup2(&actions, out, STDOUT_FILENO);
+        posix_spawn_file_actions_addclose(&actions, out);
+    }
+
+    // The processes of a job share a process group, the shell sends its signals to the group
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK);
+    posix_spawnattr_setpgroup(&attr, pgid);
+    posix_spawnattr_setsigmask(&attr, mask);
+
+    int error = posix_spawn(&pid, path, &actions, &attr, argv, environ);
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    if (error != 0) {
+        errno = error;
+        return -1;
+    }
+    DEBUG_PRINTF("[%d] Child process executing command '%s'\n", pid, argv[0]);
+    return pid;
+}
+
+#else
+
+int spawnCommand(int in, int out, const char *path, char **argv, const sigset_t *mask, int pgid) {
+    int forkPID = fork(); // Make a child process to execute the command
+
+    if (forkPID == 0) { // Child process
+        // The shell reads its signals from a signalfd, the command must receive them normally
+        sigprocmask(SIG_SETMASK, mask, NULL);
+
+        DEBUG_PRINTF("[%d] Child process executing command '%s'\n", getpid(), argv[0]);
+        // Handle input redirection
+        if (in != STDIN_FILENO) {
+            DEBUG_PRINTF("Input read from %d\n", in);
+            dup2(in, STDIN_FILENO);
+            close(in);
+        }
+
+        // Handle output redirection
+        if (out != STDOUT_FILENO) {
+            DEBUG_PRINTF("Output redirected to %d\n", out);
+            dup2(out, STDOUT_FILENO);
+            close(out);
+        }
+
+        // The processes of a job share a process group, the shell sends its signals to the group
+        setpgid(0, pgid);
+        execv(path, argv);
+        perror(argv[0]); // If execv returns, the command has failed
+        _exit(EXIT_FAILURE); // The atexit handlers and the stdio buffers belong to the shell
+    }
+    if (forkPID > 0) {
+        setpgid(forkPID, pgid); // Also in the parent: the group must exist when the call returns
+    }
+    return forkPID;
+}
+
+#endif
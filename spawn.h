@@ -0,0 +1,33 @@
+/*
+ * Start external commands
+ */
+
+#ifndef __SPAWN_H
+#define __SPAWN_H
+
+#ifndef USE_POSIX_SPAWN
+#define USE_POSIX_SPAWN 1 // (0/1) to start commands with fork+exec/posix_spawn
+#endif
+
+#include <signal.h>
+
+/*
+ * Function: spawnCommand
+ * ----------------------
+ *   Start a command in a process group, with its input and output redirected
+ *
+ *   Notes: with posix_spawn, a missing file is reported by the parent (-1 and
+ *   errno = ENOENT), with fork+exec the child prints an error and exits
+ *
+ *   in: the input descriptor of the command
+ *   out: the output descriptor of the command
+ *   path: the file to execute
+ *   argv: the command and its arguments, terminated by NULL
+ *   mask: the signal mask of the command
+ *   pgid: the process group of the command, 0 to start a new group led by the command
+ *
+ *   Return: the PID of the created process, or -1 if it couldn't be created (errno is set)
+ */
+int spawnCommand(int in, int out, const char *path, char **argv, const sigset_t *mask, int pgid);
+
+#endif
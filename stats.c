@@ -0,0 +1,116 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "stats.h"
+
+// Each power of two is split into 2^SUB_BUCKET_BITS buckets
+#define SUB_BUCKET_BITS 4
+#define SUB_BUCKETS (1 << SUB_BUCKET_BITS)
+
+// Values below SUB_BUCKETS have their own bucket, then one group of buckets per power of two
+#define BUCKETS ((64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS)
+
+typedef struct histogram {
+    uint64_t counts[BUCKETS];
+    uint64_t total; // Number of recorded values
+    uint64_t max;   // Largest recorded value
+} histogram;
+
+static histogram histograms[STAT_PHASES];
+
+static const char *phaseNames[STAT_PHASES] = {
+    [STAT_PARSE] = "parse",
+    [STAT_SETUP] = "setup",
+    [STAT_SPAWN] = "spawn",
+    [STAT_REAPING] = "reaping",
+    [STAT_COMMAND] = "command",
+};
+
+// Bucket of a value: its highest bit gives the group, the next bits the bucket in the group
+static int bucketOf(uint64_t value) {
+    if (value < SUB_BUCKETS) {
+        return value;
+    }
+    int magnitude = 63 - __builtin_clzll(value); // >= SUB_BUCKET_BITS
+    int shift = magnitude - SUB_BUCKET_BITS;
+    return (shift + 1) * SUB_BUCKETS + ((value >> shift) & (SUB_BUCKETS - 1));
+}
+
+// Largest value of a bucket
+static uint64_t bucketEnd(int bucket) {
+    if (bucket < SUB_BUCKETS) {
+        return bucket;
+    }
+    int shift = bucket / SUB_BUCKETS - 1;
+    uint64_t start = (uint64_t)(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+    return start + (((uint64_t)1 << shift) - 1);
+}
+
+uint64_t statsClock() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+void recordLatency(statPhase phase, uint64_t start) {
+    uint64_t duration = statsClock() - start;
+    histogram *h = &histograms[phase];
+    h->counts[bucketOf(duration)]++;
+    h->total++;
+    if (duration > h->max) {
+        h->max = duration;
+    }
+}
+
+// Value below which p percent of the recorded values are (within the precision of a bucket)
+static uint64_t percentile(const histogram *h, double p) {
+    uint64_t rank = (uint64_t)(p / 100 * h->total + 0.5);
+    if (rank == 0) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (int bucket = 0; bucket < BUCKETS; bucket++) {
+        seen += h->counts[bucket];
+        if (seen >= rank) {
+            uint64_t end = bucketEnd(bucket);
+            return end < h->max ? end : h->max;
+        }
+    }
+    return h->max;
+}
+
+// Print a duration in nanoseconds with a readable unit, in a field of 10 characters
+static void printDuration(uint64_t ns) {
+    if (ns < 1000) {
+        printf("%8luns", (unsigned long)ns);
+    }
+    else if (ns < 1000000) {
+        printf("%8.1fus", ns / 1e3);
+    }
+    else if (ns < 1000000000) {
+        printf("%8.1fms", ns / 1e6);
+    }
+    else {
+        printf("%9.2fs", ns / 1e9);
+    }
+}
+
+void printStats() {
+    printf("phase        count       p50       p99       max\n");
+    for (int phase = 0; phase < STAT_PHASES; phase++) {
+        const histogram *h = &histograms[phase];
+        printf("%-8s %9lu", phaseNames[phase], (unsigned long)h->total);
+        if (h->total > 0) {
+            printDuration(percentile(h, 50));
+            printDuration(percentile(h, 99));
+            printDuration(h->max);
+        }
+        printf("\n");
+    }
+}
+
+void resetStats() {
+    memset(histograms, 0, sizeof(histograms));
+}
@@ -0,0 +1,55 @@
+/*
+ * Latency histograms of the phases of a command, shown by the stats built-in command
+ *
+ * The histograms are log-linear like HDR histograms: each power of two is split into
+ * 16 buckets, so a recorded value is known within 6.25% whatever its magnitude.
+ */
+
+#ifndef __STATS_H
+#define __STATS_H
+
+#include <stdint.h>
+
+// Phases of the handling of a command line
+typedef enum statPhase {
+    STAT_PARSE,   // readcmd: reading and splitting a command line
+    STAT_SETUP,   // treatCommand until every process of the pipeline is started
+    STAT_SPAWN,   // Start of one process, until it executes the command (posix_spawn)
+    STAT_REAPING, // Work of the shell for one ended child once notified: reaping it and
+                  // updating its job (not the delay since its exit)
+    STAT_COMMAND, // Whole command line, including the wait for the foreground job
+    STAT_PHASES   // Number of phases
+} statPhase;
+
+/*
+ * Function: statsClock
+ * --------------------
+ *   Return: the monotonic time, in nanoseconds
+ */
+uint64_t statsClock();
+
+/*
+ * Function: recordLatency
+ * -----------------------
+ *   Add a duration to the histogram of a phase
+ *
+ *   phase: the phase
+ *   start: the time at which the phase started, given by statsClock
+ */
+void recordLatency(statPhase phase, uint64_t start);
+
+/*
+ * Function: printStats
+ * --------------------
+ *   Print the number of durations, the 50th and 99th percentiles and the maximum of each phase
+ */
+void printStats();
+
+/*
+ * Function: resetStats
+ * --------------------
+ *   Empty the histograms
+ */
+void resetStats();
+
+#endif
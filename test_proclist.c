@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/wait.h>
 
 #include "proclist.h"
 
@@ -88,9 +89,69 @@ void test_updateStatus() {
     deleteProcList(head);
 }
 
+void test_jobMembers() {
+    printf("Test jobMembers\n");
+    proc_t *head = initProcList();
+    char *pipeline[] = {"cat", "file", "|", "sort", "|", "uniq", "|", "head", "|", "wc", NULL};
+
+    int id = addProcess(head, 2001, ACTIVE, pipeline);
+    for (int pid = 2002; pid <= 2005; pid++) { // More processes than stored inline
+        addProcessMember(head, id, pid);
+    }
+    printProcList(head);
+
+    printf("Process 2004 belongs to job %d (group %d)\n", getID(head, 2004), getPID(head, id));
+    printf("Set the job SUSPENDED through process 2003\n");
+    setProcessStatusByPID(head, 2003, SUSPENDED);
+    printProcList(head);
+
+    for (int pid = 2005; pid >= 2001; pid--) {
+        struct rusage usage = {.ru_utime = {0, 600000}, .ru_stime = {0, 1000}, .ru_maxrss = pid};
+        addProcessUsage(head, pid, &usage);
+        int status = (pid - 2000) << 8; // Exit status of each process: its rank in the pipeline
+        printf("Reaping %d: %d processes left\n", pid, reapProcessByPID(head, pid, status));
+    }
+    int status = getProcessExitStatusByPID(head, 2003);
+    printf("Exit status of the job (status of 2005, 5): %d\n", WEXITSTATUS(status));
+    printf("Resources used by the job (user 3s, sys 0.005s, max RSS 2005 KiB)\n");
+    printProcListUsage(head);
+
+    printf("Removing the job\n");
+    removeProcessByPID(head, 2001);
+    printf("Process 2004 belongs to job %d\n", getID(head, 2004));
+    printProcList(head);
+    deleteProcList(head);
+}
+
+void test_queuedJob() {
+    printf("Test queuedJob\n");
+    proc_t *head = initProcList();
+    char *running[] = {"sleep", "100", NULL};
+    char *queued[] = {"make", "-j", "8", NULL};
+
+    addProcess(head, 3001, ACTIVE, running);
+    int id = addProcess(head, 0, QUEUED, queued);
+    printProcList(head);
+    printf("Active: %d, queued: %d (1, 1)\n", countProcesses(head, ACTIVE),
+           countProcesses(head, QUEUED));
+    printf("Job %d has PID %d and process 0 belongs to job %d\n", id, getPID(head, id),
+           getID(head, 0));
+
+    printf("Start the queued job with process 3002\n");
+    addProcessMember(head, id, 3002);
+    setProcessStatusByID(head, id, ACTIVE);
+    printf("Job %d has PID %d, active: %d, queued: %d (2, 0)\n", id, getPID(head, id),
+           countProcesses(head, ACTIVE), countProcesses(head, QUEUED));
+    removeProcessByPID(head, 3001);
+    printf("Active after removing 3001: %d\n", countProcesses(head, ACTIVE));
+    deleteProcList(head);
+}
+
 int main() {
     test_addProcess();
     test_removeProcess();
     test_updateStatus();
+    test_jobMembers();
+    test_queuedJob();
     return 0;
 }
\ No newline at end of file
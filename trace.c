@@ -0,0 +1,176 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "trace.h"
+
+// Size of the command name stored in an event (truncated)
+#define TRACE_NAME_SIZE 20
+
+_Static_assert((TRACE_EVENTS & (TRACE_EVENTS - 1)) == 0, "TRACE_EVENTS must be a power of two");
+
+// An event, fixed-size so that recording it is a few stores
+typedef struct traceRecord {
+    uint64_t time;               // CLOCK_MONOTONIC time, in nanoseconds
+    long value;                  // Meaning given by type
+    int pid;                     // Process concerned, 0 for the shell
+    unsigned char type;          // traceType
+    char name[TRACE_NAME_SIZE];  // Command name, empty if none
+} traceRecord;
+
+bool traceEnabled = false;
+
+static traceRecord ring[TRACE_EVENTS];
+static uint64_t nextEvent = 0; // Number of events recorded since the last clear
+static char *exitPath = NULL;  // File written at exit
+static pid_t exitPID = 0;      // Process writing it, not the children exiting after a fork
+
+// Name and phase (B: begin, E: end, i: instant) of each type in the trace format
+static const struct {
+    const char *name;
+    char phase;
+} traceTypes[] = {
+    [TRACE_COMMAND_BEGIN] = {"command", 'B'},
+    [TRACE_COMMAND_END] = {"command", 'E'},
+    [TRACE_SPAWN] = {"spawn", 'i'},
+    [TRACE_BUILTIN_BEGIN] = {"builtin", 'B'},
+    [TRACE_BUILTIN_END] = {"builtin", 'E'},
+    [TRACE_WAIT_BEGIN] = {"wait foreground", 'B'},
+    [TRACE_WAIT_END] = {"wait foreground", 'E'},
+    [TRACE_SIGNAL] = {"signal", 'i'},
+    [TRACE_STOP] = {"stop", 'i'},
+    [TRACE_CONTINUE] = {"continue", 'i'},
+    [TRACE_REAP] = {"reap", 'i'},
+};
+
+void traceEvent(traceType type, int pid, long value, const char *name) {
+    uint64_t slot = __atomic_fetch_add(&nextEvent, 1, __ATOMIC_RELAXED);
+    traceRecord *r = &ring[slot & (TRACE_EVENTS - 1)];
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    r->time = (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+    r->value = value;
+    r->pid = pid;
+    r->type = type;
+    if (name != NULL) {
+        strncpy(r->name, name, TRACE_NAME_SIZE - 1);
+        r->name[TRACE_NAME_SIZE - 1] = '\0';
+    }
+    else {
+        r->name[0] = '\0';
+    }
+}
+
+void setTracing(bool enabled) {
+    DEBUG_PRINTF("Tracing %s\n", enabled ? "enabled" : "disabled");
+    traceEnabled = enabled;
+}
+
+void clearTrace() {
+    nextEvent = 0;
+}
+
+long countTraceEvents() {
+    return nextEvent < TRACE_EVENTS ? (long)nextEvent : TRACE_EVENTS;
+}
+
+// Write a string in a JSON string, escaping what must be
+static void writeJSONString(FILE *f, const char *s) {
+    fputc('"', f);
+    for (; *s != '\0'; s++) {
+        if (*s == '"' || *s == '\\') {
+            fprintf(f, "\\%c", *s);
+        }
+        else if ((unsigned char)*s < 0x20) {
+            fprintf(f, "\\u%04x", *s);
+        }
+        else {
+            fputc(*s, f);
+        }
+    }
+    fputc('"', f);
+}
+
+int dumpTrace(const char *path) {
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        return -1;
+    }
+    int shellPID = getpid();
+    fprintf(f, "{\"traceEvents\": [\n");
+    fprintf(f, "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": %d, "
+               "\"args\": {\"name\": \"minishell\"}}",
+            shellPID, shellPID);
+
+    uint64_t end = nextEvent;
+    uint64_t start = end > TRACE_EVENTS ? end - TRACE_EVENTS : 0;
+    // The begin and end events are all on the thread of the shell, nested. An end whose begin
+    // was overwritten in the ring or recorded before "trace on" is skipped: it would close
+    // an enclosing event in the viewers
+    int openEvents = 0;
+    for (uint64_t i = start; i < end; i++) {
+        const traceRecord *r = &ring[i & (TRACE_EVENTS - 1)];
+        if (traceTypes[r->type].phase == 'B') {
+            openEvents++;
+        }
+        else if (traceTypes[r->type].phase == 'E') {
+            if (openEvents == 0) {
+                continue;
+            }
+            openEvents--;
+        }
+        // The shell is a thread of the trace, each instant event about a process is on its own
+        int tid = (traceTypes[r->type].phase == 'i' && r->pid != 0) ? r->pid : shellPID;
+        if (r->type == TRACE_SPAWN) {
+            fprintf(f, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": %d, "
+                       "\"args\": {\"name\": ",
+                    shellPID, tid);
+            writeJSONString(f, r->name);
+            fprintf(f, "}}");
+        }
+        fprintf(f, ",\n{\"name\": \"%s\", \"cat\": \"minishell\", \"ph\": \"%c\", \"ts\": %.3f, "
+                   "\"pid\": %d, \"tid\": %d",
+                traceTypes[r->type].name, traceTypes[r->type].phase, r->time / 1e3, shellPID, tid);
+        if (traceTypes[r->type].phase == 'i') {
+            fprintf(f, ", \"s\": \"t\"");
+        }
+        fprintf(f, ", \"args\": {\"pid\": %d, \"value\": %ld, \"command\": ", r->pid, r->value);
+        writeJSONString(f, r->name);
+        fprintf(f, "}}");
+    }
+    fprintf(f, "\n]}\n");
+    return fclose(f);
+}
+
+static void dumpAtExit() {
+    if (getpid() != exitPID) {
+        return;
+    }
+    if (dumpTrace(exitPath) < 0) {
+        perror(exitPath);
+    }
+    free(exitPath);
+}
+
+void traceAtExit(const char *path) {
+    if (exitPath == NULL) {
+        atexit(dumpAtExit);
+    }
+    free(exitPath);
+    // A relative path is resolved now: the current directory may change before the exit
+    char *cwd = path[0] != '/' ? getcwd(NULL, 0) : NULL;
+    if (cwd != NULL) {
+        exitPath = safe_malloc(strlen(cwd) + strlen(path) + 2);
+        sprintf(exitPath, "%s/%s", cwd, path);
+        free(cwd);
+    }
+    else {
+        exitPath = strdup(path);
+    }
+    exitPID = getpid();
+    setTracing(true);
+}
@@ -0,0 +1,103 @@
+/*
+ * Runtime tracing of the shell: events are recorded in a ring buffer and dumped in the
+ * Chrome trace event format (JSON), which chrome://tracing and Perfetto can open
+ *
+ * Tracing is off by default, a disabled TRACE is a single test of traceEnabled.
+ * It is started by MINISHELL_TRACE=<file> (dumped to the file when the shell exits)
+ * or by the trace built-in command.
+ */
+
+#ifndef __TRACE_H
+#define __TRACE_H
+
+#include <stdbool.h>
+
+// Number of events kept, the oldest ones are overwritten (must be a power of two)
+#ifndef TRACE_EVENTS
+#define TRACE_EVENTS 65536
+#endif
+
+// Events recorded by the shell
+typedef enum traceType {
+    TRACE_COMMAND_BEGIN, // A command line starts (value: number of stages)
+    TRACE_COMMAND_END,   // The command line is done
+    TRACE_SPAWN,         // A process is created (pid, value: its process group)
+    TRACE_BUILTIN_BEGIN, // A built-in command starts in the shell
+    TRACE_BUILTIN_END,   // The built-in command returned (value: exit status)
+    TRACE_WAIT_BEGIN,    // The shell waits for a foreground job (pid: process group)
+    TRACE_WAIT_END,      // The foreground job ended or stopped
+    TRACE_SIGNAL,        // A signal is read from the signalfd (value: signal number)
+    TRACE_STOP,          // A process is stopped (pid, value: signal number)
+    TRACE_CONTINUE,      // A process is resumed (pid)
+    TRACE_REAP,          // A process ended (pid, value: wait status)
+} traceType;
+
+extern bool traceEnabled; // Are events recorded ?
+
+// Record an event if tracing is enabled, name is copied (truncated) and may be NULL
+#define TRACE(type, pid, value, name)                                                              \
+    do {                                                                                           \
+        if (__builtin_expect(traceEnabled, 0)) {                                                   \
+            traceEvent(type, pid, value, name);                                                    \
+        }                                                                                          \
+    } while (0)
+
+/*
+ * Function: traceEvent
+ * --------------------
+ *   Record an event in the ring buffer, use the TRACE macro instead
+ *
+ *   Notes: the slot is reserved with an atomic increment, so that an event can be
+ *   recorded from a signal handler without a lock
+ *
+ *   type: the type of the event
+ *   pid: the process concerned by the event, 0 for the shell
+ *   value: a number whose meaning depends on type
+ *   name: a command name or NULL
+ */
+void traceEvent(traceType type, int pid, long value, const char *name);
+
+/*
+ * Function: setTracing
+ * --------------------
+ *   Start or stop recording events, the recorded ones are kept
+ *
+ *   enabled: record the events ?
+ */
+void setTracing(bool enabled);
+
+/*
+ * Function: clearTrace
+ * --------------------
+ *   Forget the recorded events
+ */
+void clearTrace();
+
+/*
+ * Function: countTraceEvents
+ * --------------------------
+ *   Return: the number of events in the ring buffer
+ */
+long countTraceEvents();
+
+/*
+ * Function: dumpTrace
+ * -------------------
+ *   Write the recorded events to a file, in the Chrome trace event format
+ *
+ *   path: the file to write
+ *
+ *   Return: 0 on success, -1 if the file couldn't be written (errno is set)
+ */
+int dumpTrace(const char *path);
+
+/*
+ * Function: traceAtExit
+ * ---------------------
+ *   Start tracing and dump the events to a file when the shell exits
+ *
+ *   path: the file to write, copied, relative to the current directory when it is called
+ */
+void traceAtExit(const char *path);
+
+#endif
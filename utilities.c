@@ -0,0 +1,534 @@
+#define _GNU_SOURCE // get_current_dir_name
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "utilities.h"
+
+// Maximum number of bytes moved by cat between two checks of CTRL+C
+#define RELAY_CHUNK (1 << 20)
+
+int echo(char **argv, int in, int out, proc_t *procList) {
+    (void)in;
+    (void)out;
+    (void)procList;
+    bool newline = true;
+    char **args = argv + 1;
+    if (*args != NULL && !strcmp(*args, "-n")) {
+        newline = false;
+        args++;
+    }
+    for (; *args != NULL; args++) {
+        fputs(*args, stdout);
+        if (args[1] != NULL) {
+            putchar(' ');
+        }
+    }
+    if (newline) {
+        putchar('\n');
+    }
+    return 0;
+}
+
+int trueCommand(char **argv, int in, int out, proc_t *procList) {
+    (void)argv;
+    (void)in;
+    (void)out;
+    (void)procList;
+    return 0;
+}
+
+int falseCommand(char **argv, int in, int out, proc_t *procList) {
+    (void)argv;
+    (void)in;
+    (void)out;
+    (void)procList;
+    return 1;
+}
+
+int pwd(char **argv, int in, int out, proc_t *procList) {
+    (void)argv;
+    (void)in;
+    (void)out;
+    (void)procList;
+    char *dir = get_current_dir_name();
+    if (dir == NULL) {
+        perror("minishell: pwd");
+        return 1;
+    }
+    puts(dir);
+    free(dir);
+    return 0;
+}
+
+/*
+ * printf
+ */
+
+// Value of an octal digit, -1 if c is not one
+static int octalDigit(char c) {
+    return (c >= '0' && c <= '7') ? c - '0' : -1;
+}
+
+// Print the escape sequence starting after a backslash, return the number of characters used.
+// Octal values are \NNN in a format and \0NNN in an argument of %b
+static int printEscape(const char *s, bool argument) {
+    if (octalDigit(*s) >= 0 && (!argument || *s == '0')) {
+        int value = 0, n = argument ? 1 : 0;
+        int digits = n + 3;
+        while (n < digits && octalDigit(s[n]) >= 0) {
+            value = value * 8 + octalDigit(s[n++]);
+        }
+        putchar(value);
+        return n;
+    }
+    switch (*s) {
+    case 'a': putchar('\a'); return 1;
+    case 'b': putchar('\b'); return 1;
+    case 'f': putchar('\f'); return 1;
+    case 'n': putchar('\n'); return 1;
+    case 'r': putchar('\r'); return 1;
+    case 't': putchar('\t'); return 1;
+    case 'v': putchar('\v'); return 1;
+    case '\\': putchar('\\'); return 1;
+    case '\0':
+        putchar('\\');
+        return 0;
+    default:
+        putchar('\\');
+        putchar(*s);
+        return 1;
+    }
+}
+
+// Numeric value of a printf argument ('c is the code of c), set *error if it is not a number
+static long long numericArgument(const char *arg, bool *error) {
+    if (arg[0] == '\'' || arg[0] == '"') {
+        return (unsigned char)arg[1];
+    }
+    char *end;
+    errno = 0;
+    long long value = strtoll(arg, &end, 0);
+    if (end == arg || *end != '\0' || errno != 0) {
+        fprintf(stderr, "minishell: printf: %s: invalid number\n", arg);
+        *error = true;
+    }
+    return value;
+}
+
+// Print the format once, consuming arguments from *args, return false on an error
+static bool printFormat(const char *format, char ***args) {
+    bool error = false;
+    for (const char *c = format; *c != '\0'; c++) {
+        if (*c == '\\') {
+            c += printEscape(c + 1, false);
+            continue;
+        }
+        if (*c != '%') {
+            putchar(*c);
+            continue;
+        }
+        if (c[1] == '%') {
+            putchar('%');
+            c++;
+            continue;
+        }
+
+        // Copy the conversion specification, flags, width and precision are given to printf
+        char spec[32] = "%";
+        size_t n = 1;
+        c++;
+        while (*c != '\0' && strchr("-+ #0123456789.", *c) != NULL && n < sizeof(spec) - 4) {
+            spec[n++] = *c++;
+        }
+        if (*c == '\0') {
+            fprintf(stderr, "minishell: printf: %s: missing conversion\n", spec);
+            return false;
+        }
+        const char *arg = **args;
+        if (arg != NULL) {
+            (*args)++;
+        }
+        switch (*c) {
+        case 's':
+        case 'c':
+            spec[n++] = *c;
+            spec[n] = '\0';
+            if (*c == 's') {
+                printf(spec, arg != NULL ? arg : "");
+            }
+            else if (arg != NULL && arg[0] != '\0') {
+                printf(spec, arg[0]);
+            }
+            break;
+        case 'b': // String with escape sequences
+            for (const char *s = arg != NULL ? arg : ""; *s != '\0'; s++) {
+                if (*s == '\\') {
+                    s += printEscape(s + 1, true);
+                }
+                else {
+                    putchar(*s);
+                }
+            }
+            break;
+        case 'd':
+        case 'i':
+        case 'o':
+        case 'u':
+        case 'x':
+        case 'X':
+            spec[n++] = 'l';
+            spec[n++] = 'l';
+            spec[n++] = *c;
+            spec[n] = '\0';
+            printf(spec, arg != NULL ? numericArgument(arg, &error) : 0LL);
+            break;
+        default:
+            fprintf(stderr, "minishell: printf: %%%c: invalid conversion\n", *c);
+            return false;
+        }
+    }
+    return !error;
+}
+
+int printfCommand(char **argv, int in, int out, proc_t *procList) {
+    (void)in;
+    (void)out;
+    (void)procList;
+    if (argv[1] == NULL) {
+        fprintf(stderr, "minishell: printf: usage: printf format [arguments]\n");
+        return 2;
+    }
+    char **args = argv + 2;
+    bool success;
+    // The format is reused as long as it consumes arguments
+    do {
+        char **before = args;
+        success = printFormat(argv[1], &args);
+        if (args == before) {
+            break;
+        }
+    } while (success && *args != NULL);
+    return success ? 0 : 1;
+}
+
+/*
+ * test
+ *
+ * Grammar, from the lowest to the highest precedence:
+ *   or      := and [-o or]
+ *   and     := not [-a and]
+ *   not     := ! not | primary
+ *   primary := ( or ) | unary-operator operand | operand binary-operator operand | operand
+ */
+
+typedef struct testParser {
+    char **args;      // Remaining arguments
+    const char *name; // Name used in error messages (test or [)
+    bool error;       // Error found ?
+    bool reported;    // Error message already printed ?
+} testParser;
+
+static bool testOr(testParser *p);
+
+static int remainingArguments(testParser *p) {
+    int n = 0;
+    while (p->args[n] != NULL) {
+        n++;
+    }
+    return n;
+}
+
+static bool isBinaryOperator(const char *op) {
+    static const char *operators[] = {"=", "==", "!=", "-eq", "-ne", "-lt", "-le",
+                                      "-gt", "-ge", "-nt", "-ot", NULL};
+    for (const char **o = operators; *o != NULL; o++) {
+        if (!strcmp(*o, op)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static long long integerOperand(testParser *p, const char *arg) {
+    char *end;
+    errno = 0;
+    long long value = strtoll(arg, &end, 10);
+    if (end == arg || *end != '\0' || errno != 0) {
+        fprintf(stderr, "minishell: %s: %s: integer expression expected\n", p->name, arg);
+        p->error = p->reported = true;
+    }
+    return value;
+}
+
+static bool binaryTest(testParser *p, const char *left, const char *op, const char *right) {
+    if (!strcmp(op, "=") || !strcmp(op, "==")) {
+        return !strcmp(left, right);
+    }
+    if (!strcmp(op, "!=")) {
+        return strcmp(left, right) != 0;
+    }
+    if (!strcmp(op, "-nt") || !strcmp(op, "-ot")) {
+        struct stat l, r;
+        bool hasLeft = stat(left, &l) == 0, hasRight = stat(right, &r) == 0;
+        if (!strcmp(op, "-ot")) {
+            return hasRight && (!hasLeft || l.st_mtim.tv_sec < r.st_mtim.tv_sec ||
+                                (l.st_mtim.tv_sec == r.st_mtim.tv_sec &&
+                                 l.st_mtim.tv_nsec < r.st_mtim.tv_nsec));
+        }
+        return hasLeft && (!hasRight || l.st_mtim.tv_sec > r.st_mtim.tv_sec ||
+                           (l.st_mtim.tv_sec == r.st_mtim.tv_sec &&
+                            l.st_mtim.tv_nsec > r.st_mtim.tv_nsec));
+    }
+    long long a = integerOperand(p, left), b = integerOperand(p, right);
+    switch (op[1] * 256 + op[2]) {
+    case 'e' * 256 + 'q': return a == b;
+    case 'n' * 256 + 'e': return a != b;
+    case 'l' * 256 + 't': return a < b;
+    case 'l' * 256 + 'e': return a <= b;
+    case 'g' * 256 + 't': return a > b;
+    default: return a >= b; // -ge
+    }
+}
+
+// Return -1 if op isn't a unary operator
+static int unaryTest(const char *op, const char *arg) {
+    if (op[0] != '-' || op[1] == '\0' || op[2] != '\0') {
+        return -1;
+    }
+    struct stat st;
+    switch (op[1]) {
+    case 'n': return arg[0] != '\0';
+    case 'z': return arg[0] == '\0';
+    case 'e': return stat(arg, &st) == 0;
+    case 'f': return stat(arg, &st) == 0 && S_ISREG(st.st_mode);
+    case 'd': return stat(arg, &st) == 0 && S_ISDIR(st.st_mode);
+    case 'p': return stat(arg, &st) == 0 && S_ISFIFO(st.st_mode);
+    case 'b': return stat(arg, &st) == 0 && S_ISBLK(st.st_mode);
+    case 'c': return stat(arg, &st) == 0 && S_ISCHR(st.st_mode);
+    case 'S': return stat(arg, &st) == 0 && S_ISSOCK(st.st_mode);
+    case 's': return stat(arg, &st) == 0 && st.st_size > 0;
+    case 'h':
+    case 'L': return lstat(arg, &st) == 0 && S_ISLNK(st.st_mode);
+    case 'r': return access(arg, R_OK) == 0;
+    case 'w': return access(arg, W_OK) == 0;
+    case 'x': return access(arg, X_OK) == 0;
+    case 't': return isatty(atoi(arg));
+    default: return -1;
+    }
+}
+
+static bool testPrimary(testParser *p) {
+    int n = remainingArguments(p);
+    if (n == 0) {
+        p->error = true;
+        return false;
+    }
+    char **a = p->args;
+    // A binary operator in second position wins, so that "test -n = -n" compares strings
+    if (n >= 3 && isBinaryOperator(a[1])) {
+        p->args += 3;
+        return binaryTest(p, a[0], a[1], a[2]);
+    }
+    if (!strcmp(a[0], "(")) {
+        p->args++;
+        bool value = testOr(p);
+        if (p->args[0] == NULL || strcmp(p->args[0], ")") != 0) {
+            p->error = true;
+            return false;
+        }
+        p->args++;
+        return value;
+    }
+    if (n >= 2) {
+        int value = unaryTest(a[0], a[1]);
+        if (value >= 0) {
+            p->args += 2;
+            return value;
+        }
+    }
+    p->args++;
+    return a[0][0] != '\0';
+}
+
+static bool testNot(testParser *p) {
+    // A lone "!" is a non-empty string
+    if (p->args[0] != NULL && !strcmp(p->args[0], "!") && p->args[1] != NULL) {
+        p->args++;
+        return !testNot(p);
+    }
+    return testPrimary(p);
+}
+
+static bool testAnd(testParser *p) {
+    bool value = testNot(p);
+    while (p->args[0] != NULL && !strcmp(p->args[0], "-a")) {
+        p->args++;
+        value = testNot(p) && value;
+    }
+    return value;
+}
+
+static bool testOr(testParser *p) {
+    bool value = testAnd(p);
+    while (p->args[0] != NULL && !strcmp(p->args[0], "-o")) {
+        p->args++;
+        value = testAnd(p) || value;
+    }
+    return value;
+}
+
+int test(char **argv, int in, int out, proc_t *procList) {
+    (void)in;
+    (void)out;
+    (void)procList;
+    testParser p = {argv + 1, argv[0], false, false};
+
+    // [ needs a closing ], which is removed from the expression
+    int argc = remainingArguments(&p);
+    if (!strcmp(argv[0], "[")) {
+        if (argc == 0 || strcmp(argv[argc], "]") != 0) {
+            fprintf(stderr, "minishell: [: missing `]'\n");
+            return 2;
+        }
+        argc--;
+    }
+    char *last = argv[argc + 1];
+    argv[argc + 1] = NULL;
+
+    bool value = argc > 0 && testOr(&p); // No expression is false
+    if (p.args[0] != NULL) {
+        p.error = true;
+    }
+    argv[argc + 1] = last;
+    if (p.error) {
+        if (!p.reported) {
+            fprintf(stderr, "minishell: %s: syntax error\n", p.name);
+        }
+        return 2;
+    }
+    return value ? 0 : 1;
+}
+
+/*
+ * cat
+ */
+
+bool isPlainCat(char **argv) {
+    if (strcmp(argv[0], "cat") != 0) {
+        return false;
+    }
+    for (char **arg = argv + 1; *arg != NULL; arg++) {
+        if ((*arg)[0] == '-' && (*arg)[1] != '\0') {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Was CTRL+C pressed ? The shell blocks SIGINT, in a subprocess it kills cat anyway
+static bool interrupted() {
+    sigset_t pending;
+    return sigpending(&pending) == 0 && sigismember(&pending, SIGINT);
+}
+
+// Wait until fd can be read, return false if CTRL+C is pressed first
+static bool waitInput(int fd) {
+    struct pollfd p = {fd, POLLIN, 0};
+    while (!interrupted()) {
+        int ready = poll(&p, 1, 100);
+        if (ready != 0 && (ready > 0 || errno != EINTR)) {
+            return true; // Ready, or an error reported by the next read
+        }
+    }
+    return false;
+}
+
+// Copy with read and write, when the kernel can't move the data between in and out
+static int copyData(int in, int out, bool waitForInput) {
+    static char buffer[1 << 16];
+    while (!interrupted()) {
+        if (waitForInput && !waitInput(in)) {
+            return 0;
+        }
+        ssize_t n = read(in, buffer, sizeof(buffer));
+        if (n <= 0) {
+            return n;
+        }
+        for (ssize_t written = 0; written < n;) {
+            ssize_t w = write(out, buffer + written, n - written);
+            if (w < 0) {
+                return -1;
+            }
+            written += w;
+        }
+    }
+    return 0;
+}
+
+// Move everything from in to out without copying it through user space when possible
+static int relay(int in, int out) {
+    struct stat inStat, outStat;
+    if (fstat(in, &inStat) < 0 || fstat(out, &outStat) < 0) {
+        return -1;
+    }
+    // Regular files are always ready, a pipe or a terminal may have to be waited for
+    bool waitForInput = !S_ISREG(inStat.st_mode) && !S_ISBLK(inStat.st_mode);
+    bool pipes = S_ISFIFO(inStat.st_mode) || S_ISFIFO(outStat.st_mode);
+    while (!interrupted()) {
+        if (waitForInput && !waitInput(in)) {
+            return 0;
+        }
+        // splice needs a pipe on one side, sendfile needs an input that can be mapped
+        ssize_t n = pipes ? splice(in, NULL, out, NULL, RELAY_CHUNK, SPLICE_F_MOVE | SPLICE_F_MORE)
+                          : sendfile(out, in, NULL, RELAY_CHUNK);
+        if (n == 0) {
+            return 0;
+        }
+        if (n < 0) {
+            return (errno == EINVAL || errno == ENOSYS) ? copyData(in, out, waitForInput) : -1;
+        }
+    }
+    return 0;
+}
+
+int cat(char **argv, int in, int out, proc_t *procList) {
+    (void)procList;
+    fflush(stdout); // The data is written directly to out, after the previous output
+    if (argv[1] == NULL) {
+        if (relay(in, out) < 0) {
+            // Like the SIGPIPE which would kill the external cat, a closed reader ends silently
+            if (errno != EPIPE) {
+                fprintf(stderr, "cat: %s\n", strerror(errno));
+            }
+            return 1;
+        }
+        return 0;
+    }
+    int status = 0;
+    for (char **arg = argv + 1; *arg != NULL && !interrupted(); arg++) {
+        int file = strcmp(*arg, "-") ? open(*arg, O_RDONLY | O_CLOEXEC) : in;
+        bool failed = file < 0 || relay(file, out) < 0;
+        int error = errno;
+        if (file >= 0 && file != in) {
+            close(file);
+        }
+        if (failed) {
+            status = 1;
+            if (error == EPIPE) {
+                break;
+            }
+            fprintf(stderr, "cat: %s: %s\n", *arg, strerror(error));
+        }
+    }
+    return status;
+}
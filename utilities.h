@@ -0,0 +1,89 @@
+/*
+ * Built-in versions of common utilities, they save a fork and an exec for each use
+ *
+ * They have the signature of the built-in commands (see builtins.h) and report their
+ * errors on the standard error, like the external utilities they replace.
+ */
+
+#ifndef __UTILITIES_H
+#define __UTILITIES_H
+
+#include <stdbool.h>
+
+#include "proclist.h"
+
+#ifndef OPTIMIZE_CAT
+#define OPTIMIZE_CAT 1 // (0/1) to replace cat without options by a redirection or a relay
+#endif
+
+#ifndef CAT_IN_SHELL
+#define CAT_IN_SHELL 0 // (0/1) to run the relay replacing cat in the shell instead of a subprocess
+#endif
+
+/*
+ * Function: echo
+ * --------------
+ *   Print the arguments separated by spaces, followed by a newline unless -n is given
+ */
+int echo(char **argv, int in, int out, proc_t *procList);
+
+/*
+ * Function: trueCommand
+ * ---------------------
+ *   Do nothing, successfully
+ */
+int trueCommand(char **argv, int in, int out, proc_t *procList);
+
+/*
+ * Function: falseCommand
+ * ----------------------
+ *   Do nothing, unsuccessfully
+ */
+int falseCommand(char **argv, int in, int out, proc_t *procList);
+
+/*
+ * Function: pwd
+ * -------------
+ *   Print the current directory
+ */
+int pwd(char **argv, int in, int out, proc_t *procList);
+
+/*
+ * Function: printfCommand
+ * -----------------------
+ *   Print the arguments according to a format, like printf(1): the conversions
+ *   %s %b %c %d %i %o %u %x %X with flags, width and precision, and the escape
+ *   sequences of C. The format is reused while arguments remain.
+ */
+int printfCommand(char **argv, int in, int out, proc_t *procList);
+
+/*
+ * Function: test
+ * --------------
+ *   Evaluate a conditional expression, like test(1), also called as [ with a closing ]
+ *
+ *   Return: 0 if the expression is true, 1 if it is false, 2 on a syntax error
+ */
+int test(char **argv, int in, int out, proc_t *procList);
+
+/*
+ * Function: isPlainCat
+ * --------------------
+ *   Is a command cat with only files as arguments (no options), which the shell can run itself ?
+ *
+ *   argv: the command and its arguments
+ */
+bool isPlainCat(char **argv);
+
+/*
+ * Function: cat
+ * -------------
+ *   Copy the given files (the input if none is given, or for -) to the output, with
+ *   splice when a pipe is involved and sendfile otherwise, so that the data isn't copied
+ *   through user space. The copy stops at CTRL+C.
+ *
+ *   Notes: options are not supported, see isPlainCat
+ */
+int cat(char **argv, int in, int out, proc_t *procList);
+
+#endif